@@ -0,0 +1,101 @@
+#!/bin/sh
+# Run scc_bench against every state of the module, as root:
+#   unloaded  the module is not loaded
+#   idle      every syscall is hooked, the event logger is disabled
+#   draining  enabled, a reader drains /dev/scc
+#   stalled   enabled, a reader keeps /dev/scc open but never reads, so the rings overflow
+#
+# usage: bench/run.sh [-t max_threads] [-d duration_ms] [-s syscall,...] [-k scc.ko] [-b backend]
+# Prints a single table, see scc_bench.c for its columns.
+set -eu
+
+MODULE=$(dirname "$0")/../scc.ko
+THREADS=$(nproc)
+DURATION=1000
+SYSCALLS=getpid,pipe,openat,futex
+BACKEND=
+while getopts t:d:s:k:b: opt; do
+    case $opt in
+    t) THREADS=$OPTARG ;;
+    d) DURATION=$OPTARG ;;
+    s) SYSCALLS=$OPTARG ;;
+    k) MODULE=$OPTARG ;;
+    b) BACKEND=$OPTARG ;;
+    *) sed -n 's/^# usage: //p' "$0" >&2; exit 2 ;;
+    esac
+done
+MODULE=$(realpath -m "$MODULE")
+cd "$(dirname "$0")"
+
+[ "$(id -u)" -eq 0 ] || { echo "run.sh must run as root" >&2; exit 1; }
+[ -f "$MODULE" ] || { echo "$MODULE not found, build the module first" >&2; exit 1; }
+make -s scc_bench
+
+# unhooking releases the module in the background, once the tasks in hooked syscalls returned
+unload() {
+    echo unhook > /dev/scc
+    tries=0
+    until rmmod scc 2>/dev/null; do
+        tries=$((tries + 1))
+        [ "$tries" -lt 50 ] || { echo "scc is still in use" >&2; return 1; }
+        sleep 0.1
+    done
+}
+
+READER=
+HOLDER=
+cleanup() {
+    [ -n "$READER" ] && kill "$READER" 2>/dev/null
+    [ -n "$HOLDER" ] && kill "$HOLDER" 2>/dev/null
+    wait 2>/dev/null
+    if grep -q '^scc ' /proc/modules; then
+        echo disable > /dev/scc
+        unload
+    fi
+}
+trap cleanup EXIT INT TERM
+
+# the x86_64 numbers of the syscalls each bench issues
+bench_syscalls() {
+    list=
+    for name in $(echo "$SYSCALLS" | tr , ' '); do
+        case $name in
+        getpid) nrs=39 ;;
+        pipe) nrs=0,1 ;;
+        openat) nrs=257,3 ;;
+        futex) nrs=202 ;;
+        *) echo "unknown bench $name" >&2; return 1 ;;
+        esac
+        list=${list:+$list,}$nrs
+    done
+    echo "$list"
+}
+HOOKED=$(bench_syscalls)
+
+bench() {
+    ./scc_bench -l "$1" -t "$THREADS" -d "$DURATION" -s "$SYSCALLS" ${2:-}
+}
+
+if grep -q '^scc ' /proc/modules; then
+    unload
+fi
+bench unloaded -H
+
+insmod "$MODULE" ${BACKEND:+backend=$BACKEND}
+echo hook > /dev/scc
+# name them too, a syscall the module cannot hook fails the write instead of being benched unhooked
+echo "hook $HOOKED" > /dev/scc || { echo "cannot hook $HOOKED, the results would not measure them" >&2; exit 1; }
+bench idle
+
+echo enable > /dev/scc
+cat /dev/scc > /dev/null &
+READER=$!
+bench draining
+kill "$READER"
+wait "$READER" 2>/dev/null || true
+READER=
+
+# events are only captured while someone has the device open
+sleep infinity < /dev/scc &
+HOLDER=$!
+bench stalled
@@ -0,0 +1,264 @@
+// Measure the cost of representative syscalls, on 1 to N threads.
+//
+// Prints one tab separated line per syscall and thread count:
+//   state syscall threads ops ns_per_op mops_per_sec
+// ns_per_op is the time a thread spends per call, mops_per_sec the throughput of all threads.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// calls between two looks at the clock
+#define BATCH 256
+
+struct bench
+{
+    const char *name;
+    // per thread, returns 0 on success
+    int (*setup)(void **state);
+    // one iteration, may be several syscalls, see `calls`
+    void (*run)(void *state);
+    void (*teardown)(void *state);
+    unsigned int calls;
+};
+
+struct worker
+{
+    pthread_t thread;
+    const struct bench *bench;
+    uint64_t ops;
+    uint64_t ns;
+    int error;
+};
+
+static pthread_barrier_t start_barrier;
+static atomic_bool stop;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// getpid, the cheapest syscall there is, always through the kernel
+static void run_getpid(void *state)
+{
+    (void)state;
+    syscall(SYS_getpid);
+}
+
+// write and read back one byte on a pipe of the thread
+static int setup_pipe(void **state)
+{
+    int *fds = malloc(2 * sizeof(int));
+    if (!fds || pipe(fds) < 0)
+    {
+        free(fds);
+        return -1;
+    }
+    *state = fds;
+    return 0;
+}
+
+static void run_pipe(void *state)
+{
+    const int *fds = state;
+    char c = 0;
+    if (write(fds[1], &c, 1) != 1 || read(fds[0], &c, 1) != 1)
+        abort();
+}
+
+static void teardown_pipe(void *state)
+{
+    int *fds = state;
+    close(fds[0]);
+    close(fds[1]);
+    free(fds);
+}
+
+// openat and close, the path is captured when strings are on
+static void run_openat(void *state)
+{
+    (void)state;
+    const int fd = openat(AT_FDCWD, "/dev/null", O_RDONLY);
+    if (fd < 0)
+        abort();
+    close(fd);
+}
+
+// wake a futex nobody waits on
+static int setup_futex(void **state)
+{
+    *state = calloc(1, sizeof(uint32_t));
+    return *state ? 0 : -1;
+}
+
+static void run_futex(void *state)
+{
+    syscall(SYS_futex, state, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void teardown_free(void *state)
+{
+    free(state);
+}
+
+static const struct bench benches[] = {
+    {"getpid", NULL, run_getpid, NULL, 1},
+    {"pipe", setup_pipe, run_pipe, teardown_pipe, 2},
+    {"openat", NULL, run_openat, NULL, 2},
+    {"futex", setup_futex, run_futex, teardown_free, 1},
+};
+
+static void *worker_main(void *arg)
+{
+    struct worker *worker = arg;
+    const struct bench *bench = worker->bench;
+    void *state = NULL;
+    if (bench->setup && bench->setup(&state) < 0)
+        worker->error = errno;
+
+    pthread_barrier_wait(&start_barrier);
+    if (worker->error)
+        return NULL;
+
+    const uint64_t start = now_ns();
+    uint64_t ops = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed))
+    {
+        for (int i = 0; i < BATCH; ++i)
+            bench->run(state);
+        ops += BATCH;
+    }
+    worker->ns = now_ns() - start;
+    worker->ops = ops * bench->calls;
+
+    if (bench->teardown)
+        bench->teardown(state);
+    return NULL;
+}
+
+static int run_bench(const char *label, const struct bench *bench, int threads, unsigned int duration_ms)
+{
+    struct worker *workers = calloc(threads, sizeof(struct worker));
+    if (!workers)
+        return -1;
+
+    atomic_store(&stop, false);
+    pthread_barrier_init(&start_barrier, NULL, threads + 1);
+    for (int i = 0; i < threads; ++i)
+    {
+        workers[i].bench = bench;
+        if (pthread_create(&workers[i].thread, NULL, worker_main, workers + i) != 0)
+        {
+            fprintf(stderr, "Failed to start thread %d\n", i);
+            exit(1);
+        }
+    }
+
+    pthread_barrier_wait(&start_barrier);
+    const struct timespec duration = {duration_ms / 1000, (duration_ms % 1000) * 1000000L};
+    nanosleep(&duration, NULL);
+    atomic_store(&stop, true);
+
+    uint64_t ops = 0, ns = 0;
+    int rc = 0;
+    for (int i = 0; i < threads; ++i)
+    {
+        pthread_join(workers[i].thread, NULL);
+        if (workers[i].error)
+        {
+            fprintf(stderr, "Failed to set up %s: %s\n", bench->name, strerror(workers[i].error));
+            rc = -1;
+        }
+        ops += workers[i].ops;
+        ns += workers[i].ns;
+    }
+    pthread_barrier_destroy(&start_barrier);
+    free(workers);
+
+    if (rc == 0 && ops)
+        printf("%s\t%s\t%d\t%llu\t%.1f\t%.3f\n", label, bench->name, threads, (unsigned long long)ops,
+               (double)ns / ops, (double)ops * threads / ns * 1000);
+    fflush(stdout);
+    return rc;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [-l label] [-t max_threads] [-d duration_ms] [-s syscall,...] [-H]\n"
+            "  syscalls: getpid, pipe, openat, futex (default all)\n"
+            "  -H prints the header line\n",
+            argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *label = "unknown";
+    const char *only = NULL;
+    int max_threads = 1;
+    unsigned int duration_ms = 1000;
+    int opt;
+    while ((opt = getopt(argc, argv, "l:t:d:s:H")) != -1)
+    {
+        switch (opt)
+        {
+        case 'l':
+            label = optarg;
+            break;
+        case 't':
+            max_threads = atoi(optarg);
+            break;
+        case 'd':
+            duration_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            only = optarg;
+            break;
+        case 'H':
+            printf("state\tsyscall\tthreads\tops\tns_per_op\tmops_per_sec\n");
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (max_threads < 1 || duration_ms == 0)
+        usage(argv[0]);
+
+    int rc = 0;
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); ++i)
+    {
+        if (only)
+        {
+            // match whole names in the comma separated list
+            const size_t len = strlen(benches[i].name);
+            const char *p = only;
+            while ((p = strstr(p, benches[i].name)) && ((p != only && p[-1] != ',') || (p[len] && p[len] != ',')))
+                p += len;
+            if (!p)
+                continue;
+        }
+        // 1, 2, 4... then max_threads itself
+        for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+        {
+            if (run_bench(label, benches + i, threads, duration_ms) < 0)
+                rc = 1;
+            if (threads == max_threads)
+                break;
+        }
+    }
+    return rc;
+}
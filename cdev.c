@@ -4,10 +4,23 @@
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/mutex.h>
+#include <linux/poll.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/bitmap.h>
 
 #include "cdev.h"
 #include "syscall_hook.h"
 #include "event_logger.h"
+#include "event_filter.h"
+#include "event_prog.h"
+#include "event_sample.h"
+#include "event_compact.h"
+#include "event_strings.h"
+#include "event_ring.h"
+#include "event_consumer.h"
+#include "event_stats.h"
+#include "event_config.h"
 #include "event_schema.h"
 
 // the char device for this module interacts with user space
@@ -18,21 +31,61 @@ const static struct file_operations fops = {
     .release = CDEV_FUNC(release),
     .read = CDEV_FUNC(read),
     .write = CDEV_FUNC(write),
+    .mmap = CDEV_FUNC(mmap),
+    .poll = CDEV_FUNC(poll),
+};
+
+// events moved out of the rings at a time, a read() takes as many chunks as fit
+#define READ_CHUNK 64
+
+enum session_format
+{
+    // struct event_schema, what client.py reads
+    SESSION_FORMAT_LEGACY,
+    // blocks of varint records, see event_schema.h
+    SESSION_FORMAT_COMPACT,
+};
+
+// the state of an open /dev/scc, allocated once so that read() never allocates
+struct scc_session
+{
+    // the rings and the view of this open file, NULL unless opened for reading
+    struct event_consumer *consumer;
+    enum session_format format;
+    // serializes the readers sharing this file, they share the buffers
+    struct mutex read_mutex;
+    // only allocated for readers, keep last
+    struct event_record records[READ_CHUNK];
+    struct event_strings strings[READ_CHUNK];
+    u8 compact_buf[READ_CHUNK * EVENT_COMPACT_SIZE_MAX];
 };
 
 static int major = 0, minor = 0;
 static dev_t scc_dev;
 static struct class *scc_class;
-static DEFINE_MUTEX(io_mutex);
 
-static ssize_t detail_event_to_user(struct event *event, size_t count, char __user *buf);
-
-// typedef dispatcher_fn
-typedef ssize_t (*dispatcher_fn)(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
-static ssize_t do_hook(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
-static ssize_t do_unhook(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
-static ssize_t do_enable(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
-static ssize_t do_disable(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos);
+static ssize_t detail_event_to_user(const struct event_record *records, size_t count, char __user *buf);
+static ssize_t compact_flush_to_user(struct scc_session *session, size_t size, char __user *buf);
+
+// typedef dispatcher_fn, @args is the rest of the command line with surrounding spaces stripped
+typedef ssize_t (*dispatcher_fn)(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_hook(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_unhook(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_enable(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_disable(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_watermark(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_timeout(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_overflow(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_filter(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_view(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_prog(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_sample(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_ratelimit(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_mode(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_latency(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_format(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_strings(struct file *filp, const char *args, size_t count, loff_t *f_pos);
+static ssize_t do_profile(struct file *filp, const char *args, size_t count, loff_t *f_pos);
 
 struct operation_dispatcher
 {
@@ -45,6 +98,19 @@ static struct operation_dispatcher dispatch_table[] = {
     {"unhook", do_unhook},
     {"enable", do_enable},
     {"disable", do_disable},
+    {"watermark", do_watermark},
+    {"timeout", do_timeout},
+    {"overflow", do_overflow},
+    {"filter", do_filter},
+    {"view", do_view},
+    {"prog", do_prog},
+    {"sample", do_sample},
+    {"ratelimit", do_ratelimit},
+    {"mode", do_mode},
+    {"latency", do_latency},
+    {"format", do_format},
+    {"strings", do_strings},
+    {"profile", do_profile},
 };
 
 int dev_init(void)
@@ -100,103 +166,242 @@ void dev_exit(void)
 
 int CDEV_FUNC(open)(struct inode *inode, struct file *filp)
 {
-    if (!mutex_trylock(&io_mutex))
+    // a control open, like `echo disable > /dev/scc`, needs neither the read buffers nor rings
+    const bool reader = filp->f_mode & FMODE_READ;
+    struct scc_session *session = kvzalloc(reader ? sizeof(struct scc_session) : offsetof(struct scc_session, records), GFP_KERNEL);
+    if (!session)
+        return -ENOMEM;
+
+    // every reader gets its own rings, readers never steal the events of one another
+    if (reader)
     {
-        printk(KERN_ERR "Failed to lock scc mutex\n");
-        return -EBUSY;
+        session->consumer = event_consumer_open(current->tgid);
+        if (IS_ERR(session->consumer))
+        {
+            int rc = PTR_ERR(session->consumer);
+            kvfree(session);
+            return rc;
+        }
     }
+    mutex_init(&session->read_mutex);
+    filp->private_data = session;
     return 0;
 }
 
 int CDEV_FUNC(release)(struct inode *inode, struct file *filp)
 {
-    mutex_unlock(&io_mutex);
+    struct scc_session *session = filp->private_data;
+    if (session->consumer)
+        event_consumer_close(session->consumer);
+    mutex_destroy(&session->read_mutex);
+    kvfree(session);
     return 0;
 }
 
 ssize_t CDEV_FUNC(read)(struct file *filp, char __user *buf, size_t count, loff_t *f_pos)
 {
-    // infinite reading values from get_events(...), keep reading until signal is received
-    // or the buffer is full
-#define CAPACITY 10
-    struct event events[CAPACITY];
-    int size = 0;
-    int rc = get_events(events, &size, CAPACITY);
-    if (rc < 0)
+    struct scc_session *session = filp->private_data;
+    if (mutex_lock_interruptible(&session->read_mutex))
+        return -ERESTARTSYS;
+
+    // do_format() waits for the lock, the whole read() is in one format
+    const enum session_format format = session->format;
+    // the most a record can take, only pop what is sure to fit once serialized
+    const size_t record_size = format == SESSION_FORMAT_COMPACT ? EVENT_COMPACT_SIZE_MAX : sizeof(struct event_schema);
+    // compact records are encoded into compact_buf as they are popped, and copied out once it is full
+    size_t pending = 0;
+    ssize_t copied = 0, rc = 0;
+    if (count < record_size)
     {
-        printk(KERN_ERR "Failed to get events\n");
-        return -ENODATA;
+        rc = -EINVAL;
+        goto out;
     }
 
-    if (size == 0)
+    // records are tens of bytes on average, keep popping until a worst-case one may not fit
+    while (count - copied - pending >= record_size)
     {
-        printk(KERN_INFO "No events\n");
-        return 0;
+        if (format == SESSION_FORMAT_COMPACT && sizeof(session->compact_buf) - pending < record_size)
+        {
+            rc = compact_flush_to_user(session, pending, buf + copied);
+            if (rc < 0)
+                goto out;
+            copied += rc;
+            pending = 0;
+        }
+
+        int capacity = min_t(size_t, READ_CHUNK, (count - copied - pending) / record_size);
+        if (format == SESSION_FORMAT_COMPACT)
+            capacity = min_t(size_t, capacity, (sizeof(session->compact_buf) - pending) / record_size);
+        int size = 0;
+        // only the compact format has room for the strings
+        struct event_strings *strings = format == SESSION_FORMAT_COMPACT ? session->strings : NULL;
+        rc = get_events(session->consumer, session->records, strings, &size, capacity);
+        if (rc == -ENODATA)
+        {
+            // return what we have, block only until the first events
+            if (copied || pending)
+                break;
+            if (filp->f_flags & O_NONBLOCK)
+            {
+                rc = -EAGAIN;
+                goto out;
+            }
+            rc = event_rings_wait(session->consumer->rings);
+            if (rc < 0)
+                goto out;
+            continue;
+        }
+        if (rc < 0)
+        {
+            printk(KERN_ERR "Failed to get events\n");
+            goto out;
+        }
+
+        if (format == SESSION_FORMAT_COMPACT)
+            pending += event_compact_encode(session->records, session->strings, size, session->compact_buf + pending);
+        else
+        {
+            rc = detail_event_to_user(session->records, size, buf + copied);
+            if (rc < 0)
+                goto out;
+            copied += rc;
+        }
+
+        // the rings are drained
+        if (size < capacity)
+            break;
+        cond_resched();
     }
 
-    return detail_event_to_user(events, size, buf);
-#undef CAPACITY
+    rc = 0;
+out:
+    if (pending)
+    {
+        const ssize_t flushed = compact_flush_to_user(session, pending, buf + copied);
+        if (flushed < 0)
+            rc = flushed;
+        else
+            copied += flushed;
+    }
+    mutex_unlock(&session->read_mutex);
+    // the events already copied are gone from the rings, report them rather than the error
+    return copied ? copied : rc;
+}
+
+__poll_t CDEV_FUNC(poll)(struct file *filp, struct poll_table_struct *wait)
+{
+    struct scc_session *session = filp->private_data;
+    // opened write-only, there will never be anything to read
+    if (!session->consumer)
+        return EPOLLERR;
+    return event_rings_poll(session->consumer->rings, filp, wait);
+}
+
+int CDEV_FUNC(mmap)(struct file *filp, struct vm_area_struct *vma)
+{
+    struct scc_session *session = filp->private_data;
+    if (!session->consumer)
+        return -EACCES;
+    int rc = event_rings_mmap(session->consumer->rings, vma);
+    if (rc < 0)
+        printk(KERN_ERR "Failed to map the event rings\n");
+    return rc;
 }
 
 ssize_t CDEV_FUNC(write)(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
 {
-    static char buf_local[256] = {0};
-    if (count >= sizeof(buf_local))
+// large enough for a filter program
+#define MAX_COMMAND_SIZE PAGE_SIZE
+    if (count == 0 || count >= MAX_COMMAND_SIZE)
     {
         printk(KERN_ERR "Invalid count %ld\n", count);
         return -EINVAL;
     }
-    if (copy_from_user(buf_local, buf, count))
+#undef MAX_COMMAND_SIZE
+    char *buf_local = memdup_user_nul(buf, count);
+    if (IS_ERR(buf_local))
     {
         printk(KERN_ERR "Failed to copy from user space\n");
         return -EINVAL;
     }
 
+    // "<name> [args...]", the name has to match a dispatcher exactly
+    char *args = strim(buf_local);
+    const char *name = strsep(&args, " \t");
+    args = args ? strim(args) : "";
+
+    ssize_t rc = -EINVAL;
     for (int i = 0; i < sizeof(dispatch_table) / sizeof(dispatch_table[0]); ++i)
     {
-        const size_t dispatcher_name_len = strlen(dispatch_table[i].name);
-        const int len = min(dispatcher_name_len, count - 1);
-        if (strncmp(buf_local, dispatch_table[i].name, len) == 0)
+        if (strcmp(name, dispatch_table[i].name) == 0)
         {
-            return dispatch_table[i].functor(filp, buf, count, f_pos);
+            rc = dispatch_table[i].functor(filp, args, count, f_pos);
+            goto out;
         }
     }
 
     // not found
-    printk(KERN_ERR "Invalid operation %s\n", buf);
-    return -EINVAL;
+    printk(KERN_ERR "Invalid operation %s\n", name);
+out:
+    kfree(buf_local);
+    return rc;
 }
 
-static ssize_t detail_event_to_user(struct event *event, size_t count, char __user *buf)
+// the consumer of a file opened for reading, the per-file settings only make sense there
+static struct event_consumer *session_consumer(struct file *filp)
 {
-    struct event_schema *schema = kmalloc(count * sizeof(struct event_schema), GFP_KERNEL);
-    if (!schema)
-    {
-        printk(KERN_ERR "Failed to allocate memory\n");
-        return -ENOMEM;
-    }
+    struct scc_session *session = filp->private_data;
+    if (!session->consumer)
+        printk(KERN_ERR "Open /dev/scc for reading to change its own settings\n");
+    return session->consumer;
+}
 
+static ssize_t detail_event_to_user(const struct event_record *records, size_t count, char __user *buf)
+{
+    // the schema is already converted at capture time, copy it straight out of the records
     for (int i = 0; i < count; ++i)
     {
-        event_to_schema(event + i, schema + i);
+        if (copy_to_user(buf + i * sizeof(struct event_schema), &records[i].schema, sizeof(struct event_schema)))
+        {
+            printk(KERN_ERR "Failed to copy to user space\n");
+            return -EINVAL;
+        }
     }
 
-    unsigned long _ = copy_to_user(buf, schema, count * sizeof(struct event_schema));
-    if (_ != 0)
+    return count * sizeof(struct event_schema);
+}
+
+// copy the first @size bytes of compact_buf, the records encoded so far
+static ssize_t compact_flush_to_user(struct scc_session *session, size_t size, char __user *buf)
+{
+    if (copy_to_user(buf, session->compact_buf, size))
     {
         printk(KERN_ERR "Failed to copy to user space\n");
-        kfree(schema);
-        return -EINVAL;
+        return -EFAULT;
     }
+    return size;
+}
 
-    kfree(schema);
+// parse "59,42,257" or "0-10" style syscall lists, an empty list means all syscalls
+static int parse_syscall_list(const char *args, unsigned long *syscalls)
+{
+    if (*args == '\0')
+        return 1;
 
-    return count * sizeof(struct event_schema);
+    int rc = bitmap_parselist(args, syscalls, HOOK_NR_SYSCALLS);
+    if (rc < 0)
+        printk(KERN_ERR "Invalid syscall list %s, syscalls must be below %d\n", args, HOOK_NR_SYSCALLS);
+    return rc;
 }
 
-static ssize_t do_hook(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
+static ssize_t do_hook(struct file *filp, const char *args, size_t count, loff_t *f_pos)
 {
-    int rc = hook_syscall();
+    DECLARE_BITMAP(syscalls, HOOK_NR_SYSCALLS);
+    int rc = parse_syscall_list(args, syscalls);
+    if (rc < 0)
+        return rc;
+
+    rc = hook_syscall(rc > 0 ? NULL : syscalls);
     if (rc < 0)
     {
         printk(KERN_ERR "Failed to hook syscall\n");
@@ -205,9 +410,14 @@ static ssize_t do_hook(struct file *filp, const char __user *buf, size_t count,
     return count;
 }
 
-static ssize_t do_unhook(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
+static ssize_t do_unhook(struct file *filp, const char *args, size_t count, loff_t *f_pos)
 {
-    int rc = unhook_syscall();
+    DECLARE_BITMAP(syscalls, HOOK_NR_SYSCALLS);
+    int rc = parse_syscall_list(args, syscalls);
+    if (rc < 0)
+        return rc;
+
+    rc = unhook_syscall(rc > 0 ? NULL : syscalls);
     if (rc < 0)
     {
         printk(KERN_ERR "Failed to unhook syscall\n");
@@ -218,18 +428,334 @@ static ssize_t do_unhook(struct file *filp, const char __user *buf, size_t count
     return count;
 }
 
-static ssize_t do_enable(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
+static ssize_t do_enable(struct file *filp, const char *args, size_t count, loff_t *f_pos)
 {
-    enable_event_logger(1);
+    int rc = enable_event_logger(1);
+    if (rc < 0)
+        return rc;
     printk(KERN_INFO "Enabled syscall event logger\n");
 
     return count;
 }
 
-static ssize_t do_disable(struct file *filp, const char __user *buf, size_t count, loff_t *f_pos)
+static ssize_t do_disable(struct file *filp, const char *args, size_t count, loff_t *f_pos)
 {
-    enable_event_logger(0);
+    int rc = enable_event_logger(0);
+    if (rc < 0)
+        return rc;
     printk(KERN_INFO "Disabled syscall event logger\n");
 
     return count;
 }
+
+static ssize_t do_watermark(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    struct event_consumer *consumer = session_consumer(filp);
+    if (!consumer)
+        return -EBADF;
+    unsigned int watermark, timeout_ms;
+    event_rings_get_wakeup(consumer->rings, &watermark, &timeout_ms);
+    if (kstrtouint(args, 0, &watermark))
+    {
+        printk(KERN_ERR "Invalid watermark %s\n", args);
+        return -EINVAL;
+    }
+    event_rings_set_wakeup(consumer->rings, watermark, timeout_ms);
+    printk(KERN_INFO "Set wakeup watermark to %u events\n", watermark);
+
+    return count;
+}
+
+static ssize_t do_timeout(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    struct event_consumer *consumer = session_consumer(filp);
+    if (!consumer)
+        return -EBADF;
+    unsigned int watermark, timeout_ms;
+    event_rings_get_wakeup(consumer->rings, &watermark, &timeout_ms);
+    if (kstrtouint(args, 0, &timeout_ms))
+    {
+        printk(KERN_ERR "Invalid timeout %s\n", args);
+        return -EINVAL;
+    }
+    event_rings_set_wakeup(consumer->rings, watermark, timeout_ms);
+    printk(KERN_INFO "Set wakeup timeout to %u ms\n", timeout_ms);
+
+    return count;
+}
+
+// "<drop-oldest|drop-newest|block> [us]", per open like the wakeup thresholds
+static ssize_t do_overflow(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    static const char *const policies[] = {
+        [EVENT_OVERFLOW_DROP_OLDEST] = "drop-oldest",
+        [EVENT_OVERFLOW_DROP_NEWEST] = "drop-newest",
+        [EVENT_OVERFLOW_BLOCK] = "block",
+    };
+    struct event_consumer *consumer = session_consumer(filp);
+    if (!consumer)
+        return -EBADF;
+
+    char word[16];
+    unsigned int block_us = 100;
+    if (sscanf(args, "%15s %u", word, &block_us) < 1)
+    {
+        printk(KERN_ERR "Invalid overflow policy %s\n", args);
+        return -EINVAL;
+    }
+    int overflow = match_string(policies, ARRAY_SIZE(policies), word);
+    if (overflow < 0)
+    {
+        printk(KERN_ERR "Invalid overflow policy %s\n", args);
+        return -EINVAL;
+    }
+
+    event_rings_set_overflow(consumer->rings, overflow, block_us);
+    printk(KERN_INFO "Set the overflow policy to %s\n", policies[overflow]);
+
+    return count;
+}
+
+// "<syscall|tgid|uid|comm> <include|exclude> [list]", returns the offset of the list
+static int parse_filter(const char *args, enum event_filter_kind *kind, bool *exclude)
+{
+    static const char *const kinds[] = {
+        [EVENT_FILTER_SYSCALL] = "syscall",
+        [EVENT_FILTER_TGID] = "tgid",
+        [EVENT_FILTER_UID] = "uid",
+        [EVENT_FILTER_COMM] = "comm",
+    };
+
+    char words[2][16];
+    int consumed = 0;
+    if (sscanf(args, "%15s %15s %n", words[0], words[1], &consumed) != 2)
+        goto invalid;
+
+    int matched = match_string(kinds, ARRAY_SIZE(kinds), words[0]);
+    *exclude = strcmp(words[1], "exclude") == 0;
+    if (matched < 0 || (!*exclude && strcmp(words[1], "include") != 0))
+        goto invalid;
+    *kind = matched;
+    return consumed;
+
+invalid:
+    printk(KERN_ERR "Invalid filter %s\n", args);
+    return -EINVAL;
+}
+
+// "clear" or a filter, an empty list clears that table
+static ssize_t do_filter(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    if (strcmp(args, "clear") == 0)
+    {
+        int rc = event_filter_clear();
+        if (rc < 0)
+            return rc;
+        printk(KERN_INFO "Cleared event filters\n");
+        return count;
+    }
+
+    enum event_filter_kind kind;
+    bool exclude;
+    int consumed = parse_filter(args, &kind, &exclude);
+    if (consumed < 0)
+        return consumed;
+
+    int rc = event_filter_set(kind, exclude, args + consumed);
+    if (rc < 0)
+    {
+        printk(KERN_ERR "Failed to set the filter %s\n", args);
+        return rc;
+    }
+    printk(KERN_INFO "Set the filter %s\n", args);
+
+    return count;
+}
+
+// same as "filter", but only narrows what this open file receives
+static ssize_t do_view(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    struct event_consumer *consumer = session_consumer(filp);
+    if (!consumer)
+        return -EBADF;
+    if (strcmp(args, "clear") == 0)
+    {
+        event_consumer_clear_filter(consumer);
+        printk(KERN_INFO "Cleared the view\n");
+        return count;
+    }
+
+    enum event_filter_kind kind;
+    bool exclude;
+    int consumed = parse_filter(args, &kind, &exclude);
+    if (consumed < 0)
+        return consumed;
+
+    int rc = event_consumer_set_filter(consumer, kind, exclude, args + consumed);
+    if (rc < 0)
+    {
+        printk(KERN_ERR "Failed to set the view %s\n", args);
+        return rc;
+    }
+    printk(KERN_INFO "Set the view %s\n", args);
+
+    return count;
+}
+
+static ssize_t do_prog(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    int rc = event_prog_load(args);
+    if (rc < 0)
+    {
+        printk(KERN_ERR "Failed to load the filter program %s\n", args);
+        return rc;
+    }
+    printk(KERN_INFO "%s the filter program\n", *args ? "Loaded" : "Removed");
+
+    return count;
+}
+
+// "<every> [syscalls]", capture one in every syscalls of the list, or of all syscalls
+static ssize_t do_sample(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    unsigned int every;
+    int consumed = 0;
+    if (sscanf(args, "%u %n", &every, &consumed) != 1)
+    {
+        printk(KERN_ERR "Invalid sampling %s\n", args);
+        return -EINVAL;
+    }
+
+    DECLARE_BITMAP(syscalls, HOOK_NR_SYSCALLS);
+    int rc = parse_syscall_list(args + consumed, syscalls);
+    if (rc < 0)
+        return rc;
+
+    rc = event_sample_set_rate(rc > 0 ? NULL : syscalls, every);
+    if (rc < 0)
+        return rc;
+    printk(KERN_INFO "Sample one in %u syscalls\n", every);
+
+    return count;
+}
+
+// "<events per second> [burst]", 0 removes the limit
+static ssize_t do_ratelimit(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    unsigned int rate, burst = 0;
+    if (sscanf(args, "%u %u", &rate, &burst) < 1)
+    {
+        printk(KERN_ERR "Invalid rate limit %s\n", args);
+        return -EINVAL;
+    }
+
+    int rc = event_sample_set_limit(rate, burst);
+    if (rc < 0)
+        return rc;
+    printk(KERN_INFO "Limit each process to %u events per second\n", rate);
+
+    return count;
+}
+
+static ssize_t do_mode(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    static const char *const modes[] = {
+        [EVENT_LOGGER_EVENTS] = "events",
+        [EVENT_LOGGER_AGGREGATE] = "aggregate",
+    };
+
+    int mode = match_string(modes, ARRAY_SIZE(modes), args);
+    if (mode < 0)
+    {
+        printk(KERN_ERR "Invalid mode %s\n", args);
+        return -EINVAL;
+    }
+    int rc = set_event_logger_mode(mode);
+    if (rc < 0)
+        return rc;
+    printk(KERN_INFO "Switched to %s mode\n", modes[mode]);
+
+    return count;
+}
+
+static ssize_t do_latency(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    bool enable;
+    if (kstrtobool(args, &enable))
+    {
+        printk(KERN_ERR "Invalid latency %s\n", args);
+        return -EINVAL;
+    }
+    int rc = set_event_logger_latency(enable);
+    if (rc < 0)
+        return rc;
+    printk(KERN_INFO "%s syscall latency\n", enable ? "Measuring" : "Stopped measuring");
+
+    return count;
+}
+
+// negotiated per open, other readers keep their own format
+static ssize_t do_format(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    static const char *const formats[] = {
+        [SESSION_FORMAT_LEGACY] = "legacy",
+        [SESSION_FORMAT_COMPACT] = "compact",
+    };
+
+    int format = match_string(formats, ARRAY_SIZE(formats), args);
+    if (format < 0)
+    {
+        printk(KERN_ERR "Invalid format %s\n", args);
+        return -EINVAL;
+    }
+    struct scc_session *session = filp->private_data;
+    // a read() in progress keeps the format it started with
+    if (mutex_lock_interruptible(&session->read_mutex))
+        return -ERESTARTSYS;
+    session->format = format;
+    mutex_unlock(&session->read_mutex);
+    printk(KERN_INFO "Switched to the %s format\n", formats[format]);
+
+    return count;
+}
+
+// "<on|off> [syscalls]", read the string arguments of the listed syscalls, or of all of them
+static ssize_t do_strings(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    char word[8];
+    int consumed = 0;
+    bool enable;
+    if (sscanf(args, "%7s %n", word, &consumed) != 1 || kstrtobool(word, &enable))
+    {
+        printk(KERN_ERR "Invalid strings %s\n", args);
+        return -EINVAL;
+    }
+
+    DECLARE_BITMAP(syscalls, HOOK_NR_SYSCALLS);
+    int rc = parse_syscall_list(args + consumed, syscalls);
+    if (rc < 0)
+        return rc;
+
+    rc = event_strings_set(rc > 0 ? NULL : syscalls, enable);
+    if (rc < 0)
+        return rc;
+    printk(KERN_INFO "%s the string arguments\n", enable ? "Capturing" : "Stopped capturing");
+
+    return count;
+}
+
+static ssize_t do_profile(struct file *filp, const char *args, size_t count, loff_t *f_pos)
+{
+    bool enable;
+    if (kstrtobool(args, &enable))
+    {
+        printk(KERN_ERR "Invalid profile %s\n", args);
+        return -EINVAL;
+    }
+    event_config_lock();
+    event_stats_set_profiling(enable);
+    event_config_unlock();
+    printk(KERN_INFO "%s the stages of SCC\n", enable ? "Timing" : "Stopped timing");
+
+    return count;
+}
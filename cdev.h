@@ -15,6 +15,8 @@ int CDEV_FUNC(open)(struct inode *, struct file *);
 int CDEV_FUNC(release)(struct inode *, struct file *);
 ssize_t CDEV_FUNC(read)(struct file *, char __user *, size_t, loff_t *);
 ssize_t CDEV_FUNC(write)(struct file *, const char __user *, size_t, loff_t *);
+int CDEV_FUNC(mmap)(struct file *, struct vm_area_struct *);
+__poll_t CDEV_FUNC(poll)(struct file *, struct poll_table_struct *);
 
 #ifdef CDEV_NAME
 #undef CDEV_NAME
@@ -2,13 +2,24 @@
 
 import struct
 import json
+import sys
 
 # Define the corrected format string to match the struct event_schema
 EVENT_FORMAT = "IIIIQIQ6Q"
 
+# struct event_compact_header, followed by `size` bytes of varint records
+COMPACT_HEADER_FORMAT = "BBHIIIQ"
+COMPACT_VERSION = 3
+
+# the syscall_nr of a loss record, and its flag in the compact format
+EVENT_LOST_NR = -1
+EVENT_RECORD_LOST = 0x1
+
 def unpack_event(binary_data) -> dict:
     """Unpack binary data into a dictionary"""
     event_tuple = struct.unpack(EVENT_FORMAT, binary_data)
+    if event_tuple[5] == EVENT_LOST_NR & 0xffffffff:
+        return {"lost": event_tuple[12], "cpu": event_tuple[6], "timestamp": event_tuple[4]}
     event_dict = {
         "uid": event_tuple[0],
         "pid": event_tuple[1],
@@ -22,6 +33,101 @@ def unpack_event(binary_data) -> dict:
     return event_dict
 
 
+def read_varint(data, pos):
+    """Decode a LEB128 varint at pos, return it with the next position."""
+    value = shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7f) << shift
+        shift += 7
+        if byte < 0x80:
+            return value, pos
+
+
+def read_svarint(data, pos):
+    """Decode a zigzag encoded varint at pos."""
+    value, pos = read_varint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def unpack_compact(binary_data):
+    """Yield the events of the compact blocks returned by one read()."""
+    header_size = struct.calcsize(COMPACT_HEADER_FORMAT)
+    pos = 0
+    while pos < len(binary_data):
+        version, _, cpu, nr_records, size, _, timestamp = struct.unpack_from(
+            COMPACT_HEADER_FORMAT, binary_data, pos)
+        if version != COMPACT_VERSION:
+            raise ValueError(f"unsupported compact format version {version}")
+        pos += header_size
+        end = pos + size
+        seq = 0
+        for _ in range(nr_records):
+            delta, pos = read_svarint(binary_data, pos)
+            timestamp += delta
+            delta, pos = read_varint(binary_data, pos)
+            seq += delta
+            flags, pos = read_varint(binary_data, pos)
+            fields = []
+            for _ in range(5):  # syscall_nr, pid, tid, ppid, uid
+                value, pos = read_varint(binary_data, pos)
+                fields.append(value)
+            ret, pos = read_svarint(binary_data, pos)
+            weight, pos = read_varint(binary_data, pos)
+            duration, pos = read_varint(binary_data, pos)
+            nargs = binary_data[pos]
+            pos += 1
+            args = []
+            for _ in range(nargs):
+                value, pos = read_varint(binary_data, pos)
+                args.append(value)
+            nr_strings = binary_data[pos]
+            pos += 1
+            strings = {}
+            for _ in range(nr_strings):
+                arg = binary_data[pos]
+                length, pos = read_varint(binary_data, pos + 1)
+                strings[arg] = binary_data[pos:pos + length].decode(errors="replace")
+                pos += length
+            if flags & EVENT_RECORD_LOST:
+                yield {"lost": weight, "cpu": cpu, "timestamp": timestamp, "seq": seq}
+                continue
+            yield {
+                "uid": fields[4],
+                "pid": fields[1],
+                "ppid": fields[3],
+                "tid": fields[2],
+                "timestamp": timestamp,
+                "syscall_nr": fields[0],
+                "syscall_args": args,
+                "syscall_ret": ret,
+                "weight": weight,
+                "duration": duration,
+                "cpu": cpu,
+                "seq": seq,
+                "strings": strings,
+            }
+        pos = end
+
+
+def main_compact() -> None:
+    """Negotiate the compact format and print its events as JSON."""
+    with open('/dev/scc', 'r+b', buffering=0) as scc_file:
+        scc_file.write(b"format compact")
+        try:
+            while True:
+                binary_data = scc_file.read(65536)
+                if not binary_data:
+                    break
+                for event_dict in unpack_compact(binary_data):
+                    print(json.dumps(event_dict, indent=4))
+        except KeyboardInterrupt:
+            pass
+        except IOError:
+            pass
+
+
 def main() -> None:
     """Read binary data from /dev/scc and print as JSON."""
     with open('/dev/scc', 'rb') as scc_file:
@@ -40,4 +146,7 @@ def main() -> None:
 
 
 if __name__ == '__main__':
-    main()
+    if "--compact" in sys.argv[1:]:
+        main_compact()
+    else:
+        main()
@@ -0,0 +1,455 @@
+#ifndef __SCC_CLIENT_HPP__
+#define __SCC_CLIENT_HPP__
+/* A header-only C++17 consumer of /dev/scc.
+ *
+ * scc::ring_reader maps the event rings of its open file and hands the records to a
+ * callback where they lie, one contiguous batch at a time, see the mmap layout in
+ * event_schema.h. scc::stream_reader is the fallback for kernels without mmap(): one
+ * large read() of legacy records per call, handed over from its buffer the same way.
+ * Both keep backpressure statistics: the loss records, the gaps in seq and how full the
+ * rings were.
+ *
+ *     scc::device dev;
+ *     scc::ring_reader reader(dev);
+ *     while (running)
+ *         if (reader.wait(100))
+ *             reader.drain([](const scc::ring_batch &batch) {
+ *                 for (const event_record &record : batch)
+ *                     ...
+ *             });
+ *
+ * Errors are thrown as std::system_error. A reader is used from one thread at a time.
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../event_schema.h"
+
+namespace scc
+{
+
+inline bool is_lost(const event_record &record)
+{
+    return record.flags & EVENT_RECORD_LOST;
+}
+
+// in the legacy format, a loss record has its count in syscall_ret
+inline bool is_lost(const event_schema &schema)
+{
+    return schema.syscall_nr == EVENT_LOST_NR;
+}
+
+[[noreturn]] inline void throw_errno(const char *what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/**
+ * @brief An open file on /dev/scc, each one gets its own rings, filters and view.
+ */
+class device
+{
+public:
+    explicit device(const char *path = "/dev/scc")
+        : fd_(::open(path, O_RDWR | O_CLOEXEC))
+    {
+        if (fd_ < 0)
+            throw_errno("open");
+    }
+    ~device()
+    {
+        ::close(fd_);
+    }
+    device(const device &) = delete;
+    device &operator=(const device &) = delete;
+
+    /**
+     * @brief Send a command such as "watermark 256" or "view syscall include 0,1", see the README.
+     */
+    void command(std::string_view command)
+    {
+        if (::write(fd_, command.data(), command.size()) < 0)
+            throw_errno(std::string(command).c_str());
+    }
+
+    int fd() const
+    {
+        return fd_;
+    }
+
+private:
+    int fd_;
+};
+
+/**
+ * @brief Records lying contiguously in memory, iterated in place.
+ */
+template <typename Record>
+class batch
+{
+public:
+    using value_type = Record;
+    using iterator = const Record *;
+
+    batch(const Record *first, size_t size)
+        : first_(first), size_(size)
+    {
+    }
+
+    iterator begin() const
+    {
+        return first_;
+    }
+    iterator end() const
+    {
+        return first_ + size_;
+    }
+    size_t size() const
+    {
+        return size_;
+    }
+    bool empty() const
+    {
+        return size_ == 0;
+    }
+    const Record &operator[](size_t i) const
+    {
+        return first_[i];
+    }
+
+private:
+    const Record *first_;
+    size_t size_;
+};
+
+/**
+ * @brief Records of one ring, still in the ring: only valid during the callback.
+ */
+class ring_batch : public batch<event_record>
+{
+public:
+    ring_batch(const event_record *first, size_t size, uint32_t cpu, const event_strings *strings)
+        : batch(first, size), cpu_(cpu), strings_(strings)
+    {
+    }
+
+    uint32_t cpu() const
+    {
+        return cpu_;
+    }
+
+    /**
+     * @brief The strings captured from the arguments of @record, NULL if none.
+     */
+    const event_strings *strings(const event_record &record) const
+    {
+        return record.nr_strings ? strings_ + (&record - begin()) : nullptr;
+    }
+
+private:
+    uint32_t cpu_;
+    // the strings of the first record, the slots follow those of the records
+    const event_strings *strings_;
+};
+
+struct stats
+{
+    // calls of the batch callback
+    uint64_t batches = 0;
+    // every record handed over, loss records included
+    uint64_t records = 0;
+    // the syscalls the events stand for, more than the events when sampled. The legacy
+    // format has no weight, there it counts the events
+    uint64_t weight = 0;
+    // the events the loss records reported
+    uint64_t lost_reported = 0;
+    // the rest is only known with mmap, the legacy format has no seq
+    // the events missing between two records of a ring
+    uint64_t seq_gaps = 0;
+    // records handed over while the kernel was dropping them, they may be torn
+    uint64_t overrun = 0;
+    // the most records found waiting in a ring, how close the reader came to losing events
+    uint64_t max_backlog = 0;
+};
+
+/**
+ * @brief Zero-copy reader of the event rings mapped from a device.
+ *
+ * Switches its open file to the drop-newest overflow policy unless told otherwise: the
+ * kernel then never writes a slot before the reader hands it back, which is what lets
+ * the callback read the records in place. With drop-oldest, the records of a batch the
+ * kernel dropped meanwhile are counted in `overrun`.
+ */
+class ring_reader
+{
+public:
+    explicit ring_reader(device &dev, const char *overflow = "drop-newest")
+        : dev_(dev)
+    {
+        if (overflow)
+            dev_.command(std::string("overflow ") + overflow);
+
+        // the header first, it tells the size of everything else
+        const long page_size = ::sysconf(_SC_PAGESIZE);
+        void *header = ::mmap(nullptr, page_size, PROT_READ, MAP_SHARED, dev_.fd(), 0);
+        if (header == MAP_FAILED)
+            throw_errno("mmap");
+        const event_ring_header layout = static_cast<const event_ring_area *>(header)->header;
+        ::munmap(header, page_size);
+        if (layout.version != EVENT_RING_VERSION || layout.record_size != sizeof(event_record))
+            throw std::system_error(EPROTO, std::generic_category(), "unsupported ring layout");
+
+        ctrl_size_ = layout.ctrl_size;
+        void *ctrl = ::mmap(nullptr, ctrl_size_, PROT_READ, MAP_SHARED, dev_.fd(), 0);
+        if (ctrl == MAP_FAILED)
+            throw_errno("mmap");
+        // the only pages we write
+        tails_size_ = layout.records_offset - layout.tails_offset;
+        void *tails = ::mmap(nullptr, tails_size_, PROT_READ | PROT_WRITE, MAP_SHARED, dev_.fd(), layout.tails_offset);
+        if (tails == MAP_FAILED)
+        {
+            const int error = errno;
+            ::munmap(ctrl, ctrl_size_);
+            errno = error;
+            throw_errno("mmap");
+        }
+        // the records, then the strings of every slot
+        records_size_ = layout.strings_offset - layout.records_offset + (size_t)layout.nr_cpus * layout.nr_slots * layout.strings_size;
+        void *records = ::mmap(nullptr, records_size_, PROT_READ, MAP_SHARED, dev_.fd(), layout.records_offset);
+        if (records == MAP_FAILED)
+        {
+            const int error = errno;
+            ::munmap(tails, tails_size_);
+            ::munmap(ctrl, ctrl_size_);
+            errno = error;
+            throw_errno("mmap");
+        }
+
+        area_ = static_cast<const event_ring_area *>(ctrl);
+        tails_ = static_cast<event_ring_tail *>(tails);
+        records_ = static_cast<const event_record *>(records);
+        strings_ = reinterpret_cast<const event_strings *>(static_cast<const char *>(records) + layout.strings_offset - layout.records_offset);
+        nr_cpus_ = layout.nr_cpus;
+        nr_slots_ = layout.nr_slots;
+        next_seq_.assign(nr_cpus_, 0);
+    }
+    ~ring_reader()
+    {
+        ::munmap(const_cast<event_record *>(records_), records_size_);
+        ::munmap(tails_, tails_size_);
+        ::munmap(const_cast<event_ring_area *>(area_), ctrl_size_);
+    }
+    ring_reader(const ring_reader &) = delete;
+    ring_reader &operator=(const ring_reader &) = delete;
+
+    /**
+     * @brief Wait until a ring crosses the wakeup watermark, see the `watermark` and `timeout` commands.
+     *
+     * @return true if records are ready, false on timeout. A negative @timeout_ms waits forever.
+     */
+    bool wait(int timeout_ms)
+    {
+        pollfd pfd = {dev_.fd(), POLLIN, 0};
+        const int rc = ::poll(&pfd, 1, timeout_ms);
+        if (rc < 0 && errno != EINTR)
+            throw_errno("poll");
+        return rc > 0;
+    }
+
+    /**
+     * @brief Hand the queued records to @on_batch, then give their slots back to the kernel.
+     *
+     * @param on_batch Called with a `const ring_batch &`, up to twice per ring when it wraps.
+     * @param budget The most records taken from each ring, bounds the time spent per call.
+     *
+     * @return The number of records handed over.
+     */
+    template <typename Callback>
+    size_t drain(Callback &&on_batch, size_t budget = SIZE_MAX)
+    {
+        size_t total = 0;
+        for (uint32_t cpu = 0; cpu < nr_cpus_; ++cpu)
+            total += drain_ring(cpu, on_batch, budget);
+        return total;
+    }
+
+    /**
+     * @brief The records waiting in every ring.
+     */
+    uint64_t backlog() const
+    {
+        uint64_t queued = 0;
+        for (uint32_t cpu = 0; cpu < nr_cpus_; ++cpu)
+        {
+            const uint64_t tail = __atomic_load_n(&tails_[cpu].tail, __ATOMIC_RELAXED);
+            queued += __atomic_load_n(&area_->rings[cpu].head, __ATOMIC_ACQUIRE) - tail;
+        }
+        return queued;
+    }
+
+    /**
+     * @brief Every event the kernel dropped for this open file, reported in-band or not yet.
+     */
+    uint64_t kernel_lost() const
+    {
+        uint64_t lost = 0;
+        for (uint32_t cpu = 0; cpu < nr_cpus_; ++cpu)
+            lost += __atomic_load_n(&area_->rings[cpu].lost, __ATOMIC_RELAXED);
+        return lost;
+    }
+
+    const scc::stats &stats() const
+    {
+        return stats_;
+    }
+
+    uint32_t nr_cpus() const
+    {
+        return nr_cpus_;
+    }
+
+private:
+    template <typename Callback>
+    size_t drain_ring(uint32_t cpu, Callback &on_batch, size_t budget)
+    {
+        event_ring_tail &ring_tail = tails_[cpu];
+        const uint64_t tail = __atomic_load_n(&ring_tail.tail, __ATOMIC_RELAXED);
+        const uint64_t head = __atomic_load_n(&area_->rings[cpu].head, __ATOMIC_ACQUIRE);
+        // a tail pushed by the kernel after we loaded it is caught by the cmpxchg below
+        const uint64_t queued = std::min<uint64_t>(head - tail, nr_slots_);
+        const uint64_t n = std::min<uint64_t>(queued, budget);
+        if (n == 0)
+            return 0;
+        stats_.max_backlog = std::max(stats_.max_backlog, queued);
+
+        // the records up to the end of the ring, then the ones wrapped to its start
+        const size_t first = (size_t)cpu * nr_slots_;
+        const size_t slot = tail & (nr_slots_ - 1);
+        const size_t size = std::min<uint64_t>(n, nr_slots_ - slot);
+        deliver(ring_batch(records_ + first + slot, size, cpu, strings_ + first + slot), on_batch);
+        if (size < n)
+            deliver(ring_batch(records_ + first, n - size, cpu, strings_ + first), on_batch);
+
+        /* The kernel moved the tail past what we read, drop-oldest overwrote some of it. Never
+         * leave the tail behind what was delivered, the next drain would deliver it again.
+         */
+        uint64_t expected = tail;
+        while (!__atomic_compare_exchange_n(&ring_tail.tail, &expected, tail + n, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        {
+            if ((int64_t)(expected - (tail + n)) >= 0)
+                break;
+        }
+        stats_.overrun += std::min<uint64_t>(expected - tail, n);
+        return n;
+    }
+
+    template <typename Callback>
+    void deliver(const ring_batch &records, Callback &on_batch)
+    {
+        uint64_t &next_seq = next_seq_[records.cpu()];
+        for (const event_record &record : records)
+        {
+            stats_.seq_gaps += record.seq > next_seq ? record.seq - next_seq : 0;
+            if (is_lost(record))
+            {
+                // carries the seq of the next event
+                stats_.lost_reported += record.weight;
+                next_seq = record.seq;
+                continue;
+            }
+            stats_.weight += record.weight;
+            next_seq = record.seq + 1;
+        }
+        ++stats_.batches;
+        stats_.records += records.size();
+        on_batch(records);
+    }
+
+    device &dev_;
+    const event_ring_area *area_;
+    event_ring_tail *tails_;
+    const event_record *records_;
+    const event_strings *strings_;
+    size_t ctrl_size_;
+    size_t tails_size_;
+    size_t records_size_;
+    uint32_t nr_cpus_;
+    uint32_t nr_slots_;
+    // per ring, the seq expected from the next event
+    std::vector<uint64_t> next_seq_;
+    scc::stats stats_;
+};
+
+/**
+ * @brief Reader of the legacy read() format, for when mapping the rings is not an option.
+ *
+ * Each call is one read() filling a buffer of @capacity records, then one callback over it.
+ */
+class stream_reader
+{
+public:
+    explicit stream_reader(device &dev, size_t capacity = 16384)
+        : dev_(dev), buffer_(capacity)
+    {
+        dev_.command("format legacy");
+    }
+
+    /**
+     * @brief Read what is queued, blocking until the first events unless the device is non-blocking.
+     *
+     * @param on_batch Called with a `const batch<event_schema> &`, valid until the next read.
+     *
+     * @return The number of records handed over, 0 if interrupted or nothing was queued.
+     */
+    template <typename Callback>
+    size_t read(Callback &&on_batch)
+    {
+        const ssize_t rc = ::read(dev_.fd(), buffer_.data(), buffer_.size() * sizeof(event_schema));
+        if (rc < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN)
+                return 0;
+            throw_errno("read");
+        }
+
+        const batch<event_schema> records(buffer_.data(), rc / sizeof(event_schema));
+        for (const event_schema &schema : records)
+        {
+            if (is_lost(schema))
+                stats_.lost_reported += schema.syscall_ret;
+            else
+                ++stats_.weight;
+        }
+        if (records.empty())
+            return 0;
+        ++stats_.batches;
+        stats_.records += records.size();
+        on_batch(records);
+        return records.size();
+    }
+
+    const scc::stats &stats() const
+    {
+        return stats_;
+    }
+
+private:
+    device &dev_;
+    std::vector<event_schema> buffer_;
+    scc::stats stats_;
+};
+
+} // namespace scc
+
+#endif // __SCC_CLIENT_HPP__
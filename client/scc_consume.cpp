@@ -0,0 +1,118 @@
+// Drain /dev/scc as fast as possible and print the throughput once a second.
+//
+// usage: scc_consume [-r] [-d seconds] [-w watermark]
+//   -r  read() the legacy format instead of mapping the rings
+//
+// Each line is tab separated: the seconds elapsed, the records per second, then the
+// backpressure statistics so far: events lost as reported in-band, seq gaps, records
+// overrun and the largest backlog seen in a ring.
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "scc.hpp"
+
+static volatile std::sig_atomic_t stop;
+
+static void on_signal(int)
+{
+    stop = 1;
+}
+
+static void usage(const char *argv0)
+{
+    std::fprintf(stderr, "usage: %s [-r] [-d seconds] [-w watermark]\n", argv0);
+    std::exit(2);
+}
+
+template <typename Reader, typename Drain>
+static void run(Reader &reader, Drain &&drain, unsigned int duration)
+{
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    auto last = start;
+    uint64_t records = 0, last_records = 0;
+    while (!stop)
+    {
+        records += drain();
+
+        const auto now = clock::now();
+        if (now - last < std::chrono::seconds(1))
+            continue;
+        const double elapsed = std::chrono::duration<double>(now - start).count();
+        const double window = std::chrono::duration<double>(now - last).count();
+        const scc::stats &stats = reader.stats();
+        std::printf("%.1f\t%.0f\t%llu\t%llu\t%llu\t%llu\n", elapsed, (records - last_records) / window,
+                    (unsigned long long)stats.lost_reported, (unsigned long long)stats.seq_gaps,
+                    (unsigned long long)stats.overrun, (unsigned long long)stats.max_backlog);
+        std::fflush(stdout);
+        last = now;
+        last_records = records;
+        if (duration && elapsed >= duration)
+            break;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool stream = false;
+    unsigned int duration = 0, watermark = 256;
+    int opt;
+    while ((opt = getopt(argc, argv, "rd:w:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            stream = true;
+            break;
+        case 'd':
+            duration = std::strtoul(optarg, nullptr, 0);
+            break;
+        case 'w':
+            watermark = std::strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    // no SA_RESTART, a blocked read() has to return to see the signal
+    struct sigaction action = {};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    try
+    {
+        scc::device dev;
+        // wake up for batches, but never sit on a few events for long
+        dev.command("watermark " + std::to_string(watermark));
+        dev.command("timeout 10");
+
+        // the callbacks only count, what an agent would parse lies in each batch
+        if (stream)
+        {
+            scc::stream_reader reader(dev);
+            run(reader, [&] { return reader.read([](const scc::batch<event_schema> &) {}); }, duration);
+        }
+        else
+        {
+            scc::ring_reader reader(dev);
+            run(reader, [&] {
+                if (!reader.wait(100))
+                    return (size_t)0;
+                return reader.drain([](const scc::ring_batch &) {});
+            }, duration);
+        }
+    }
+    catch (const std::system_error &e)
+    {
+        std::fprintf(stderr, "scc_consume: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#!/usr/bin/python
+"""Check that the path of an openat() is captured, run as root with scc.ko loaded."""
+
+import subprocess
+import sys
+import tempfile
+import time
+
+from client import unpack_compact
+
+NR_OPENAT = 257
+DEADLINE = 5
+
+
+def command(scc_file, line: str) -> None:
+    scc_file.write(line.encode())
+
+
+def main() -> int:
+    with tempfile.NamedTemporaryFile(prefix="scc-strings-") as target, \
+            open('/dev/scc', 'r+b', buffering=0) as scc_file:
+        command(scc_file, "format compact")
+        command(scc_file, f"hook {NR_OPENAT}")
+        command(scc_file, f"strings on {NR_OPENAT}")
+        command(scc_file, "timeout 10")
+        command(scc_file, "enable")
+        try:
+            # the opens of the process reading /dev/scc are not logged, glibc open() is openat
+            subprocess.run(["cat", target.name], check=True, stdout=subprocess.DEVNULL)
+
+            start = time.monotonic()
+            while time.monotonic() - start < DEADLINE:
+                for event in unpack_compact(scc_file.read(65536)):
+                    if event.get("syscall_nr") == NR_OPENAT and event["strings"].get(1) == target.name:
+                        print(f"ok: openat of {target.name} by pid {event['pid']}")
+                        return 0
+        finally:
+            command(scc_file, "disable")
+            command(scc_file, f"strings off {NR_OPENAT}")
+            command(scc_file, f"unhook {NR_OPENAT}")
+
+    print(f"no openat of {target.name} with its path in {DEADLINE}s", file=sys.stderr)
+    return 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,135 @@
+#include <linux/hash.h>
+#include <linux/jiffies.h>
+#include <linux/atomic.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/build_bug.h>
+
+#include "event_logger.h"
+#include "event_cache.h"
+#include "event_pool.h"
+#include "event_stats.h"
+
+// 16384 slots, must be a power of 2
+#define EVENT_CACHE_BITS 14
+#define EVENT_CACHE_SIZE (1UL << EVENT_CACHE_BITS)
+#define EVENT_CACHE_MASK (EVENT_CACHE_SIZE - 1)
+// the number of slots a task may land in
+#define EVENT_CACHE_PROBES 8
+
+/* A task has at most one syscall in flight, so the task pointer alone is the key.
+ * It is only compared, never dereferenced.
+ *
+ * Slots hold pool events, whose memory stays valid while the module is loaded.
+ * So a racing reader may see a recycled event, but never a freed one, and every
+ * ownership change goes through cmpxchg on the slot.
+ */
+static struct event *event_cache[EVENT_CACHE_SIZE];
+
+static_assert(offsetof(struct event, task) == 0 && offsetof(struct event, cached_at) + sizeof(unsigned int) == sizeof(struct event),
+              "event_cache_fill() copies everything between task and cached_at.");
+
+static __always_inline struct event **event_cache_slot(const struct task_struct *task, int probe)
+{
+    return &event_cache[(hash_ptr(task, EVENT_CACHE_BITS) + probe) & EVENT_CACHE_MASK];
+}
+
+void event_cache_fill(struct event *cached, const struct event *event)
+{
+    const unsigned int pool_cpu = cached->pool_cpu;
+    const unsigned int pool_flags = cached->flags & EVENT_FLAG_STRINGS;
+    // everything between the key and cached_at, which event_cache_insert() sets
+    memcpy(&cached->info, &event->info, offsetof(struct event, cached_at) - offsetof(struct event, info));
+    cached->pool_cpu = pool_cpu;
+    cached->flags |= pool_flags;
+    WRITE_ONCE(cached->task, event->task);
+}
+
+bool event_cache_insert(struct event *event)
+{
+    struct event **victim = NULL;
+    struct event *victim_event = NULL;
+    unsigned int victim_cached_at = 0;
+
+    WRITE_ONCE(event->cached_at, (unsigned int)jiffies);
+    for (int i = 0; i < EVENT_CACHE_PROBES; ++i)
+    {
+        struct event **slot = event_cache_slot(event->task, i);
+        struct event *cached = READ_ONCE(*slot);
+        if (!cached)
+        {
+            if (cmpxchg(slot, NULL, event) == NULL)
+                return true;
+            event_stats_inc(EVENT_STAT_CACHE_RETRIES);
+            continue;
+        }
+
+        // left behind by a syscall of this task that never came back
+        if (READ_ONCE(cached->task) == event->task)
+        {
+            if (cmpxchg(slot, cached, event) == cached)
+            {
+                event_pool_free(cached);
+                return true;
+            }
+            event_stats_inc(EVENT_STAT_CACHE_RETRIES);
+            continue;
+        }
+
+        const unsigned int cached_at = READ_ONCE(cached->cached_at);
+        // time_before() on the low 32 bits of jiffies
+        if (!victim || (int)(cached_at - victim_cached_at) < 0)
+        {
+            victim = slot;
+            victim_event = cached;
+            victim_cached_at = cached_at;
+        }
+    }
+
+    // the window is full, evict its oldest in-flight event
+    if (victim && cmpxchg(victim, victim_event, event) == victim_event)
+    {
+        event_stats_inc(EVENT_STAT_CACHE_EVICTED);
+        event_pool_free(victim_event);
+        return true;
+    }
+    event_stats_inc(EVENT_STAT_CACHE_FULL);
+    event_pool_free(event);
+    return false;
+}
+
+struct event *event_cache_take(const struct task_struct *task)
+{
+    for (int i = 0; i < EVENT_CACHE_PROBES; ++i)
+    {
+        struct event **slot = event_cache_slot(task, i);
+        struct event *cached = READ_ONCE(*slot);
+        if (!cached || READ_ONCE(cached->task) != task)
+            continue;
+        if (cmpxchg(slot, cached, NULL) != cached)
+        {
+            event_stats_inc(EVENT_STAT_CACHE_RETRIES);
+            continue;
+        }
+
+        // recycled for another task between the check and the cmpxchg, put it back
+        if (unlikely(READ_ONCE(cached->task) != task))
+        {
+            if (cmpxchg(slot, NULL, cached) != NULL)
+                event_pool_free(cached);
+            continue;
+        }
+        return cached;
+    }
+    return NULL;
+}
+
+void event_cache_clear(void)
+{
+    for (unsigned long i = 0; i < EVENT_CACHE_SIZE; ++i)
+    {
+        struct event *cached = xchg(&event_cache[i], NULL);
+        if (cached)
+            event_pool_free(cached);
+    }
+}
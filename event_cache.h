@@ -0,0 +1,40 @@
+#ifndef __SCC_EVENT_CACHE_H__
+#define __SCC_EVENT_CACHE_H__
+#include <linux/types.h>
+
+struct event;
+struct task_struct;
+
+/**
+ * @brief Copy @event into @cached, a pool event about to be parked.
+ *
+ * Keeps what the pool owns, see event_pool_alloc(). Other CPUs may still be comparing the
+ * key of @cached from when it was parked last, so the key is written on its own.
+ */
+void event_cache_fill(struct event *cached, const struct event *event);
+
+/**
+ * @brief Park the in-flight event of `event->task` until its syscall returns.
+ *
+ * Lock-free and O(1): the task is hashed to a small window of slots claimed with cmpxchg.
+ * An event left behind by the same task is replaced, and if the whole window is busy the
+ * oldest in-flight event in it is evicted, so the memory stays bounded.
+ * Replaced or evicted events are given back to the event pool.
+ *
+ * @return true if @event is parked, false if it went back to the pool.
+ */
+bool event_cache_insert(struct event *event);
+
+/**
+ * @brief Take the in-flight event of @task out of the cache.
+ *
+ * @return The event, or NULL if it was never cached or has been evicted.
+ */
+struct event *event_cache_take(const struct task_struct *task);
+
+/**
+ * @brief Give every cached event back to the event pool.
+ */
+void event_cache_clear(void);
+
+#endif // __SCC_EVENT_CACHE_H__
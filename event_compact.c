@@ -0,0 +1,126 @@
+#include <linux/kernel.h>
+#include <linux/string.h>
+
+#include "event_compact.h"
+
+#ifdef CONFIG_X86_64
+// the argument count of the x86_64 syscalls, the unimplemented ones take none
+static const u8 nargs_table[] = {
+    3, 3, 3, 1, 2, 2, 2, 3, 3, 6, 3, 2, 1, 4, 4, 0, // read ... rt_sigreturn
+    3, 4, 4, 3, 3, 2, 1, 5, 0, 5, 3, 3, 3, 3, 3, 3, // ioctl ... shmctl
+    1, 2, 0, 2, 2, 1, 3, 0, 4, 3, 3, 3, 6, 6, 3, 3, // dup ... recvmsg
+    2, 3, 2, 3, 3, 4, 5, 5, 5, 0, 0, 3, 1, 4, 2, 1, // shutdown ... uname
+    3, 3, 4, 1, 2, 4, 5, 3, 3, 2, 1, 1, 2, 2, 3, 2, // semget ... getcwd
+    1, 1, 2, 2, 1, 2, 2, 1, 2, 3, 2, 2, 3, 3, 3, 1, // chdir ... umask
+    2, 2, 2, 1, 1, 4, 0, 3, 0, 1, 1, 0, 0, 2, 0, 0, // gettimeofday ... getpgrp
+    0, 2, 2, 2, 2, 3, 3, 3, 3, 1, 1, 1, 1, 2, 2, 2, // setsid ... rt_sigpending
+    4, 3, 2, 2, 2, 3, 1, 1, 2, 2, 2, 3, 2, 3, 2, 2, // rt_sigtimedwait ... sched_getparam
+    3, 1, 1, 1, 2, 2, 2, 1, 0, 0, 3, 2, 1, 5, 2, 1, // sched_setscheduler ... adjtimex
+    2, 1, 0, 1, 2, 5, 2, 2, 1, 4, 2, 2, 1, 3, 0, 3, // setrlimit ... init_module
+    2, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 3, 5, 5, 5, 4, // delete_module ... getxattr
+    4, 4, 3, 3, 3, 2, 2, 2, 2, 1, 6, 3, 3, 1, 2, 1, // lgetxattr ... io_destroy
+    5, 3, 3, 1, 3, 1, 0, 0, 5, 3, 1, 0, 4, 4, 3, 4, // io_getevents ... timer_settime
+    2, 1, 1, 2, 2, 2, 4, 1, 4, 4, 3, 2, 0, 6, 3, 5, // timer_gettime ... get_mempolicy
+    4, 1, 5, 5, 2, 3, 4, 5, 5, 4, 5, 3, 2, 0, 3, 2, // mq_open ... inotify_rm_watch
+    4, 4, 3, 4, 5, 3, 4, 3, 4, 5, 3, 4, 3, 3, 6, 5, // migrate_pages ... ppoll
+    1, 2, 3, 6, 4, 4, 4, 6, 4, 6, 3, 2, 1, 4, 4, 2, // unshare ... timerfd_gettime
+    4, 4, 2, 1, 3, 2, 1, 5, 5, 4, 5, 5, 2, 5, 4, 5, // accept4 ... name_to_handle_at
+    3, 2, 1, 4, 2, 3, 6, 6, 5, 3, 3, 4, 5, 3, 3, 2, // open_by_handle_at ... memfd_create
+    5, 3, 5, 1, 3, 3, 6, 6, 6, 4, 2, 1, 5, 6, 4,    // kexec_file_load ... rseq
+    // 335 to 423 are unused on x86_64
+    [424] = 4, 2, 6, 4, 3, 5, 2, 5, 3, 3, 2, 2, 3, 4, 3, 4, // pidfd_send_signal ... faccessat2
+    5, 6, 5, 4, 3, 4, 2, 1, 2, 5, 4, 4, 4, 3, 4, 6, // process_madvise ... futex_wait
+    4, 4, 4, 4, 4, 3, 3, 6, 6, 5, 4, 5, 5, 5,       // futex_requeue ... file_setattr
+};
+#endif
+
+unsigned int syscall_nargs(long nr)
+{
+#ifdef CONFIG_X86_64
+    if (nr >= 0 && nr < ARRAY_SIZE(nargs_table))
+        return nargs_table[nr];
+#endif
+    // a syscall newer than the table, every argument is kept
+    return 6;
+}
+
+static inline u8 *put_varint(u8 *p, u64 value)
+{
+    while (value >= 0x80)
+    {
+        *p++ = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static inline u8 *put_svarint(u8 *p, s64 value)
+{
+    return put_varint(p, ((u64)value << 1) ^ (u64)(value >> 63));
+}
+
+static inline u8 *encode_record(u8 *p, const struct event_record *record, const struct event_strings *strings, u64 prev_timestamp, u64 prev_seq)
+{
+    const struct event_schema *schema = &record->schema;
+    p = put_svarint(p, schema->timestamp - prev_timestamp);
+    p = put_varint(p, record->seq - prev_seq);
+    p = put_varint(p, record->flags);
+    p = put_varint(p, (u32)schema->syscall_nr);
+    p = put_varint(p, schema->pid);
+    p = put_varint(p, schema->tid);
+    p = put_varint(p, schema->ppid);
+    p = put_varint(p, schema->uid);
+    p = put_svarint(p, schema->syscall_ret);
+    p = put_varint(p, record->weight);
+    p = put_varint(p, record->duration);
+
+    const unsigned int nargs = record->flags & EVENT_RECORD_LOST ? 0 : syscall_nargs(schema->syscall_nr);
+    *p++ = nargs;
+    for (unsigned int i = 0; i < nargs; ++i)
+        p = put_varint(p, schema->syscall_args[i]);
+
+    const unsigned int nr_strings = record->nr_strings ? min_t(unsigned int, strings->nr, EVENT_STRINGS_MAX) : 0;
+    *p++ = nr_strings;
+    for (unsigned int i = 0; i < nr_strings; ++i)
+    {
+        const unsigned int len = min_t(unsigned int, strings->len[i], EVENT_STRING_SIZE - 1);
+        *p++ = strings->arg[i];
+        p = put_varint(p, len);
+        memcpy(p, strings->str[i], len);
+        p += len;
+    }
+    return p;
+}
+
+size_t event_compact_encode(const struct event_record *records, const struct event_strings *strings, int count, u8 *buf)
+{
+    u8 *p = buf;
+    for (int i = 0; i < count;)
+    {
+        const u32 cpu = records[i].cpu;
+        const u64 base_timestamp = records[i].schema.timestamp;
+        u8 *header = p;
+        p += sizeof(struct event_compact_header);
+
+        u64 prev_timestamp = base_timestamp, prev_seq = 0;
+        int n = 0;
+        for (; i < count && records[i].cpu == cpu; ++i, ++n)
+        {
+            p = encode_record(p, records + i, strings + i, prev_timestamp, prev_seq);
+            prev_timestamp = records[i].schema.timestamp;
+            prev_seq = records[i].seq;
+        }
+
+        const struct event_compact_header h = {
+            .version = EVENT_COMPACT_VERSION,
+            .cpu = cpu,
+            .nr_records = n,
+            .size = p - header - sizeof(struct event_compact_header),
+            .base_timestamp = base_timestamp,
+        };
+        // records are byte aligned, so is the next header
+        memcpy(header, &h, sizeof(h));
+    }
+    return p - buf;
+}
@@ -0,0 +1,29 @@
+#ifndef __SCC_EVENT_COMPACT_H__
+#define __SCC_EVENT_COMPACT_H__
+#include <linux/types.h>
+
+#include "event_schema.h"
+
+// the longest a record can get, 10 bytes per 64-bit varint and 5 per 32-bit one, 2 per string length
+#define EVENT_COMPACT_RECORD_MAX (10 + 10 + 5 + 5 * 5 + 10 + 5 + 10 + 1 + 6 * 10 + 1 + EVENT_STRINGS_MAX * (1 + 2 + EVENT_STRING_SIZE - 1))
+// the most a single record can take, when it needs a block of its own
+#define EVENT_COMPACT_SIZE_MAX (sizeof(struct event_compact_header) + EVENT_COMPACT_RECORD_MAX)
+
+/**
+ * @brief Encode @records into blocks of the compact format, see event_schema.h.
+ *
+ * Consecutive records of the same CPU share a block.
+ *
+ * @param strings The strings of records[i] in strings[i], only read when `records[i].nr_strings` is set.
+ * @param buf At least @count * EVENT_COMPACT_SIZE_MAX bytes.
+ *
+ * @return The number of bytes written to @buf.
+ */
+size_t event_compact_encode(const struct event_record *records, const struct event_strings *strings, int count, u8 *buf);
+
+/**
+ * @brief The number of arguments the syscall @nr really takes, 6 if unknown.
+ */
+unsigned int syscall_nargs(long nr);
+
+#endif // __SCC_EVENT_COMPACT_H__
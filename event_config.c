@@ -0,0 +1,69 @@
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+
+#include "event_config.h"
+
+// in effect until the first update and after event_config_exit(), never freed
+static struct scc_config default_config = {
+    .enabled = false,
+    .mode = EVENT_LOGGER_EVENTS,
+    .latency = false,
+};
+
+static struct scc_config __rcu *active_config = &default_config;
+// serializes the updates, held from event_config_edit() to the publish or discard
+static DEFINE_MUTEX(config_mutex);
+
+const struct scc_config *event_config_get(void)
+{
+    return rcu_dereference(active_config);
+}
+
+struct scc_config *event_config_edit(void)
+{
+    mutex_lock(&config_mutex);
+    const struct scc_config *old = rcu_dereference_protected(active_config, lockdep_is_held(&config_mutex));
+    struct scc_config *config = kmemdup(old, sizeof(struct scc_config), GFP_KERNEL);
+    if (!config)
+        mutex_unlock(&config_mutex);
+    return config;
+}
+
+void event_config_publish(struct scc_config *config)
+{
+    struct scc_config *old = rcu_replace_pointer(active_config, config, lockdep_is_held(&config_mutex));
+    mutex_unlock(&config_mutex);
+    if (old != &default_config)
+        kfree_rcu(old, rcu);
+}
+
+void event_config_lock(void)
+{
+    mutex_lock(&config_mutex);
+}
+
+void event_config_unlock(void)
+{
+    mutex_unlock(&config_mutex);
+}
+
+void event_config_discard(struct scc_config *config)
+{
+    kfree(config);
+    mutex_unlock(&config_mutex);
+}
+
+void event_config_exit(void)
+{
+    mutex_lock(&config_mutex);
+    struct scc_config *old = rcu_replace_pointer(active_config, &default_config, lockdep_is_held(&config_mutex));
+    mutex_unlock(&config_mutex);
+    if (old == &default_config)
+        return;
+
+    synchronize_rcu();
+    kfree(old->filter);
+    kfree(old->prog);
+    kfree(old);
+}
@@ -0,0 +1,86 @@
+#ifndef __SCC_EVENT_CONFIG_H__
+#define __SCC_EVENT_CONFIG_H__
+#include <linux/types.h>
+#include <linux/rcupdate.h>
+
+#include "event_logger.h"
+#include "syscall_hook.h"
+
+struct event_filter;
+struct event_prog;
+
+/**
+ * @brief Immutable snapshot of every knob the hooks read.
+ *
+ * The control path edits a private copy and publishes it with RCU, so a syscall sees one
+ * consistent configuration with a single pointer load and never waits for an update.
+ * The filter and the program are built by event_filter.c and event_prog.c, which free the
+ * ones they replace after a grace period.
+ */
+struct scc_config
+{
+    bool enabled;
+    enum event_logger_mode mode;
+    bool latency;
+    // NULL captures everything
+    struct event_filter *filter;
+    // NULL keeps everything
+    struct event_prog *prog;
+    // capture one in sample_every[nr] of the syscall nr, 0 or 1 captures all of them
+    u32 sample_every[HOOK_NR_SYSCALLS];
+    // events per second allowed to each process, 0 for no limit
+    u32 limit_rate;
+    u32 limit_burst;
+    // the syscalls whose string arguments are read at entry, see event_strings.h
+    DECLARE_BITMAP(strings, HOOK_NR_SYSCALLS);
+    struct rcu_head rcu;
+};
+
+/**
+ * @brief The configuration in effect.
+ *
+ * ! Must be called under rcu_read_lock(), the snapshot is only valid until rcu_read_unlock().
+ *
+ * @return Never NULL, the defaults (disabled) until something is published.
+ */
+const struct scc_config *event_config_get(void);
+
+/**
+ * @brief Start an update: lock out the other writers and copy the configuration in effect.
+ *
+ * Every successful call is followed by event_config_publish() or event_config_discard().
+ *
+ * @return The copy to modify, NULL without memory (nothing is locked then).
+ */
+struct scc_config *event_config_edit(void);
+
+/**
+ * @brief Make @config the configuration in effect and end the update.
+ *
+ * Syscalls already running may still see the previous one, call synchronize_rcu()
+ * to wait for them.
+ */
+void event_config_publish(struct scc_config *config);
+
+/**
+ * @brief Drop @config and end the update, nothing changes.
+ */
+void event_config_discard(struct scc_config *config);
+
+/**
+ * @brief Serialize a global update that lives outside the configuration with the others.
+ *
+ * ! Not to be held around event_config_edit().
+ */
+void event_config_lock(void);
+
+void event_config_unlock(void);
+
+/**
+ * @brief Go back to the defaults and free the filter and program still in effect.
+ *
+ * ! The hooks must be gone.
+ */
+void event_config_exit(void);
+
+#endif // __SCC_EVENT_CONFIG_H__
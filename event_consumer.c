@@ -0,0 +1,106 @@
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/rculist.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/err.h>
+
+#include "event_consumer.h"
+#include "event_ring.h"
+#include "event_schema.h"
+
+// readers walk it under RCU from the syscall path, writers hold consumers_mutex
+static LIST_HEAD(consumers);
+static DEFINE_MUTEX(consumers_mutex);
+
+struct event_consumer *event_consumer_open(pid_t tgid)
+{
+    struct event_consumer *consumer = kzalloc(sizeof(struct event_consumer), GFP_KERNEL);
+    if (!consumer)
+        return ERR_PTR(-ENOMEM);
+    mutex_init(&consumer->filter_mutex);
+    consumer->tgid = tgid;
+
+    consumer->rings = event_rings_create();
+    if (!consumer->rings)
+    {
+        kfree(consumer);
+        return ERR_PTR(-ENOMEM);
+    }
+
+    // never trace a consumer, its reads would feed back into the rings, but still let it read
+    consumer->excluded = event_filter_add_consumer(tgid) == 0;
+    if (!consumer->excluded)
+        printk(KERN_ERR "Too many processes read the events, %d is traced\n", tgid);
+
+    mutex_lock(&consumers_mutex);
+    list_add_tail_rcu(&consumer->node, &consumers);
+    mutex_unlock(&consumers_mutex);
+    return consumer;
+}
+
+void event_consumer_close(struct event_consumer *consumer)
+{
+    mutex_lock(&consumers_mutex);
+    list_del_rcu(&consumer->node);
+    mutex_unlock(&consumers_mutex);
+    if (consumer->excluded)
+        event_filter_remove_consumer(consumer->tgid);
+
+    // no syscall may still be pushing to its rings
+    synchronize_rcu();
+    kfree(rcu_dereference_protected(consumer->filter, true));
+    event_rings_destroy(consumer->rings);
+    mutex_destroy(&consumer->filter_mutex);
+    kfree(consumer);
+}
+
+int event_consumer_set_filter(struct event_consumer *consumer, enum event_filter_kind kind, bool exclude, const char *list)
+{
+    mutex_lock(&consumer->filter_mutex);
+    struct event_filter *old = rcu_dereference_protected(consumer->filter, lockdep_is_held(&consumer->filter_mutex));
+    struct event_filter *filter = event_filter_update(old, kind, exclude, list);
+    if (IS_ERR(filter))
+    {
+        mutex_unlock(&consumer->filter_mutex);
+        return PTR_ERR(filter);
+    }
+    rcu_assign_pointer(consumer->filter, filter);
+    mutex_unlock(&consumer->filter_mutex);
+
+    event_filter_free(old);
+    return 0;
+}
+
+void event_consumer_clear_filter(struct event_consumer *consumer)
+{
+    mutex_lock(&consumer->filter_mutex);
+    struct event_filter *old = rcu_replace_pointer(consumer->filter, NULL, lockdep_is_held(&consumer->filter_mutex));
+    mutex_unlock(&consumer->filter_mutex);
+
+    event_filter_free(old);
+}
+
+bool event_consumers_empty(void)
+{
+    return list_empty(&consumers);
+}
+
+void event_consumers_push(const struct event_record *record, const struct event_strings *strings)
+{
+    struct event_consumer *consumer;
+    list_for_each_entry_rcu(consumer, &consumers, node)
+    {
+        if (event_filter_match(rcu_dereference(consumer->filter), record->schema.syscall_nr, current))
+            event_rings_push(consumer->rings, record, strings);
+    }
+}
+
+void event_consumers_clear(void)
+{
+    struct event_consumer *consumer;
+    mutex_lock(&consumers_mutex);
+    list_for_each_entry(consumer, &consumers, node)
+        event_rings_clear(consumer->rings);
+    mutex_unlock(&consumers_mutex);
+}
@@ -0,0 +1,78 @@
+#ifndef __SCC_EVENT_CONSUMER_H__
+#define __SCC_EVENT_CONSUMER_H__
+#include <linux/types.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/rcupdate.h>
+
+#include "event_filter.h"
+
+struct event_rings;
+struct event_record;
+struct event_strings;
+
+/**
+ * @brief A reader of the event stream, one per /dev/scc opened for reading.
+ *
+ * Events are captured once and copied into the rings of every consumer whose filter
+ * they pass, so each one reads at its own pace and never steals the events of another.
+ */
+struct event_consumer
+{
+    struct list_head node;
+    struct event_rings *rings;
+    // narrows what this consumer receives, on top of the filter of struct scc_config
+    struct event_filter __rcu *filter;
+    // serializes the updates of @filter
+    struct mutex filter_mutex;
+    pid_t tgid;
+    // @tgid holds a slot of the consumer exclusion, see event_filter_add_consumer()
+    bool excluded;
+};
+
+/**
+ * @brief Register a new consumer for the process @tgid, which is not traced while there is room.
+ *
+ * @return The consumer, ERR_PTR() otherwise.
+ */
+struct event_consumer *event_consumer_open(pid_t tgid);
+
+/**
+ * @brief Unregister @consumer and free it once no syscall can still be pushing to it.
+ */
+void event_consumer_close(struct event_consumer *consumer);
+
+/**
+ * @brief Replace the include or exclude table of @kind of the filter of @consumer.
+ *
+ * @param list See event_filter_set(), an empty list clears the table.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int event_consumer_set_filter(struct event_consumer *consumer, enum event_filter_kind kind, bool exclude, const char *list);
+
+/**
+ * @brief Remove the filter of @consumer, it receives every event again.
+ */
+void event_consumer_clear_filter(struct event_consumer *consumer);
+
+/**
+ * @brief Whether nobody reads the events, so that they do not need to be captured.
+ */
+bool event_consumers_empty(void);
+
+/**
+ * @brief Copy a record to the rings of every consumer whose filter it passes.
+ *
+ * Called at the exit of the syscall, the filters check the current task.
+ *
+ * ! Must be called under rcu_read_lock().
+ */
+void event_consumers_push(const struct event_record *record, const struct event_strings *strings);
+
+/**
+ * @brief Drop everything queued for every consumer.
+ */
+void event_consumers_clear(void);
+
+#endif // __SCC_EVENT_CONSUMER_H__
@@ -0,0 +1,354 @@
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/bitmap.h>
+#include <linux/hash.h>
+#include <linux/sched.h>
+#include <linux/cred.h>
+#include <linux/uidgid.h>
+#include <linux/string.h>
+#include <linux/mutex.h>
+#include <linux/err.h>
+
+#include "event_filter.h"
+#include "syscall_hook.h"
+#include "event_config.h"
+
+// open addressing, kept at most half full so that a lookup ends quickly
+#define FILTER_SET_BITS 6
+#define FILTER_SET_SIZE (1 << FILTER_SET_BITS)
+#define FILTER_SET_MAX (FILTER_SET_SIZE / 2)
+#define FILTER_COMM_MAX 16
+#define FILTER_CONSUMERS_MAX 16
+
+// a set of tgids or uids, a slot stores the value + 1 so that 0 means empty
+struct filter_set
+{
+    unsigned int size;
+    u32 slots[FILTER_SET_SIZE];
+};
+
+struct filter_comm
+{
+    unsigned int size;
+    u8 len[FILTER_COMM_MAX];
+    char prefix[FILTER_COMM_MAX][TASK_COMM_LEN];
+};
+
+struct filter_rules
+{
+    DECLARE_BITMAP(syscalls, HOOK_NR_SYSCALLS);
+    bool has_syscalls;
+    struct filter_set tgids;
+    struct filter_set uids;
+    struct filter_comm comms;
+};
+
+/**
+ * @brief Immutable snapshot of the filter tables.
+ *
+ * The control path builds a new one and publishes it in a new struct scc_config, the
+ * hooks only read it. A NULL filter captures everything.
+ */
+struct event_filter
+{
+    struct filter_rules include;
+    struct filter_rules exclude;
+    struct rcu_head rcu;
+};
+
+/* The processes reading /dev/scc, kept out of the configuration so that a closing reader
+ * never has to allocate to stop being excluded. Slots are only ever set and cleared in
+ * place under consumers_mutex, the hooks scan the first consumers_used of them.
+ */
+static pid_t consumer_tgids[FILTER_CONSUMERS_MAX];
+// the open files of each process, one slot per process however many files it opens
+static unsigned int consumer_refs[FILTER_CONSUMERS_MAX];
+static unsigned int consumers_used;
+static DEFINE_MUTEX(consumers_mutex);
+
+static inline bool filter_set_contains(const struct filter_set *set, u32 value)
+{
+    for (u32 i = hash_32(value, FILTER_SET_BITS);; i = (i + 1) & (FILTER_SET_SIZE - 1))
+    {
+        if (set->slots[i] == 0)
+            return false;
+        if (set->slots[i] == value + 1)
+            return true;
+    }
+}
+
+static inline int filter_set_add(struct filter_set *set, u32 value)
+{
+    // it would be stored as the empty 0, neither a tgid nor a valid uid anyway
+    if (value == U32_MAX)
+        return -EINVAL;
+    if (set->size >= FILTER_SET_MAX)
+        return -ENOSPC;
+
+    for (u32 i = hash_32(value, FILTER_SET_BITS);; i = (i + 1) & (FILTER_SET_SIZE - 1))
+    {
+        if (set->slots[i] == value + 1)
+            return 0;
+        if (set->slots[i] == 0)
+        {
+            set->slots[i] = value + 1;
+            set->size++;
+            return 0;
+        }
+    }
+}
+
+static inline bool filter_comm_match(const struct filter_comm *comms, const char *comm)
+{
+    for (unsigned int i = 0; i < comms->size; ++i)
+    {
+        if (strncmp(comm, comms->prefix[i], comms->len[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+static inline bool filter_rules_any(const struct filter_rules *rules, long nr, u32 tgid, u32 uid, const char *comm)
+{
+    if (rules->has_syscalls && nr >= 0 && nr < HOOK_NR_SYSCALLS && test_bit(nr, rules->syscalls))
+        return true;
+    if (rules->tgids.size && filter_set_contains(&rules->tgids, tgid))
+        return true;
+    if (rules->uids.size && filter_set_contains(&rules->uids, uid))
+        return true;
+    return rules->comms.size && filter_comm_match(&rules->comms, comm);
+}
+
+bool event_filter_consumer(const struct task_struct *task)
+{
+    const unsigned int used = smp_load_acquire(&consumers_used);
+    for (unsigned int i = 0; i < used; ++i)
+    {
+        if (READ_ONCE(consumer_tgids[i]) == task->tgid)
+            return true;
+    }
+    return false;
+}
+
+bool event_filter_match(const struct event_filter *filter, long nr, const struct task_struct *task)
+{
+    if (likely(!filter))
+        return true;
+
+    const u32 tgid = task->tgid;
+    const u32 uid = __kuid_val(task_cred_xxx(task, uid));
+    const char *comm = task->comm;
+    if (filter_rules_any(&filter->exclude, nr, tgid, uid, comm))
+        return false;
+
+    // every non-empty include table has to match
+    const struct filter_rules *include = &filter->include;
+    if (include->has_syscalls && (nr < 0 || nr >= HOOK_NR_SYSCALLS || !test_bit(nr, include->syscalls)))
+        return false;
+    if (include->tgids.size && !filter_set_contains(&include->tgids, tgid))
+        return false;
+    if (include->uids.size && !filter_set_contains(&include->uids, uid))
+        return false;
+    if (include->comms.size && !filter_comm_match(&include->comms, comm))
+        return false;
+    return true;
+}
+
+static inline bool filter_rules_empty(const struct filter_rules *rules)
+{
+    return !rules->has_syscalls && !rules->tgids.size && !rules->uids.size && !rules->comms.size;
+}
+
+// @filter, or NULL once it is freed because it filters nothing
+static struct event_filter *drop_empty_filter(struct event_filter *filter)
+{
+    if (filter && filter_rules_empty(&filter->include) && filter_rules_empty(&filter->exclude))
+    {
+        kfree(filter);
+        return NULL;
+    }
+    return filter;
+}
+
+// publish @config with @filter, which is freed instead if it filters nothing
+static void publish_filter(struct scc_config *config, struct event_filter *filter)
+{
+    filter = drop_empty_filter(filter);
+    struct event_filter *old = config->filter;
+    config->filter = filter;
+    event_config_publish(config);
+    event_filter_free(old);
+}
+
+// a private copy of @old for the control path to modify
+static struct event_filter *copy_filter(const struct event_filter *old)
+{
+    if (old)
+        return kmemdup(old, sizeof(struct event_filter), GFP_KERNEL);
+    return kzalloc(sizeof(struct event_filter), GFP_KERNEL);
+}
+
+// start an update of the filter, NULL without memory
+static struct event_filter *edit_filter(struct scc_config **config)
+{
+    *config = event_config_edit();
+    if (!*config)
+        return NULL;
+
+    struct event_filter *filter = copy_filter((*config)->filter);
+    if (!filter)
+        event_config_discard(*config);
+    return filter;
+}
+
+static int parse_filter_list(struct filter_rules *rules, enum event_filter_kind kind, const char *list)
+{
+    switch (kind)
+    {
+    case EVENT_FILTER_SYSCALL:
+        bitmap_zero(rules->syscalls, HOOK_NR_SYSCALLS);
+        rules->has_syscalls = *list != '\0';
+        return rules->has_syscalls ? bitmap_parselist(list, rules->syscalls, HOOK_NR_SYSCALLS) : 0;
+    case EVENT_FILTER_TGID:
+    case EVENT_FILTER_UID:
+    {
+        struct filter_set *set = kind == EVENT_FILTER_TGID ? &rules->tgids : &rules->uids;
+        memset(set, 0, sizeof(*set));
+
+        char *copy = kstrdup(list, GFP_KERNEL), *cur = copy, *token;
+        if (!copy)
+            return -ENOMEM;
+        int rc = 0;
+        while (rc == 0 && (token = strsep(&cur, ",")))
+        {
+            u32 value;
+            if (*token == '\0')
+                continue;
+            rc = kstrtou32(token, 0, &value);
+            if (rc == 0)
+                rc = filter_set_add(set, value);
+        }
+        kfree(copy);
+        return rc;
+    }
+    case EVENT_FILTER_COMM:
+    {
+        struct filter_comm *comms = &rules->comms;
+        memset(comms, 0, sizeof(*comms));
+
+        for (const char *token = list; *token; token += strcspn(token, ","))
+        {
+            if (*token == ',' && *++token == '\0')
+                break;
+            const size_t len = strcspn(token, ",");
+            if (len == 0)
+                continue;
+            if (len >= TASK_COMM_LEN || comms->size >= FILTER_COMM_MAX)
+                return -EINVAL;
+            memcpy(comms->prefix[comms->size], token, len);
+            comms->len[comms->size++] = len;
+        }
+        return 0;
+    }
+    }
+    return -EINVAL;
+}
+
+struct event_filter *event_filter_update(const struct event_filter *old, enum event_filter_kind kind, bool exclude, const char *list)
+{
+    struct event_filter *filter = copy_filter(old);
+    if (!filter)
+        return ERR_PTR(-ENOMEM);
+
+    int rc = parse_filter_list(exclude ? &filter->exclude : &filter->include, kind, list);
+    if (rc < 0)
+    {
+        kfree(filter);
+        return ERR_PTR(rc);
+    }
+    return drop_empty_filter(filter);
+}
+
+void event_filter_free(struct event_filter *filter)
+{
+    if (filter)
+        kfree_rcu(filter, rcu);
+}
+
+int event_filter_set(enum event_filter_kind kind, bool exclude, const char *list)
+{
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+
+    struct event_filter *filter = event_filter_update(config->filter, kind, exclude, list);
+    if (IS_ERR(filter))
+    {
+        event_config_discard(config);
+        return PTR_ERR(filter);
+    }
+    publish_filter(config, filter);
+    return 0;
+}
+
+int event_filter_clear(void)
+{
+    struct scc_config *config;
+    struct event_filter *filter = edit_filter(&config);
+    if (!filter)
+        return -ENOMEM;
+
+    memset(&filter->include, 0, sizeof(filter->include));
+    memset(&filter->exclude, 0, sizeof(filter->exclude));
+    publish_filter(config, filter);
+    return 0;
+}
+
+int event_filter_add_consumer(pid_t tgid)
+{
+    int rc = -ENOSPC, free_slot = -1;
+    mutex_lock(&consumers_mutex);
+    for (unsigned int i = 0; i < FILTER_CONSUMERS_MAX; ++i)
+    {
+        if (consumer_refs[i] && consumer_tgids[i] == tgid)
+        {
+            consumer_refs[i]++;
+            rc = 0;
+            goto out;
+        }
+        if (!consumer_refs[i] && free_slot < 0)
+            free_slot = i;
+    }
+    if (free_slot < 0)
+        goto out;
+
+    consumer_refs[free_slot] = 1;
+    WRITE_ONCE(consumer_tgids[free_slot], tgid);
+    // the slot is set before the hooks may scan it
+    if (free_slot >= consumers_used)
+        smp_store_release(&consumers_used, free_slot + 1);
+    rc = 0;
+out:
+    mutex_unlock(&consumers_mutex);
+    return rc;
+}
+
+void event_filter_remove_consumer(pid_t tgid)
+{
+    mutex_lock(&consumers_mutex);
+    for (unsigned int i = 0; i < consumers_used; ++i)
+    {
+        if (consumer_refs[i] && consumer_tgids[i] == tgid)
+        {
+            if (--consumer_refs[i] == 0)
+                WRITE_ONCE(consumer_tgids[i], 0);
+            break;
+        }
+    }
+    // a hook still scanning the old range only finds empty slots there
+    unsigned int used = consumers_used;
+    while (used && !consumer_refs[used - 1])
+        --used;
+    WRITE_ONCE(consumers_used, used);
+    mutex_unlock(&consumers_mutex);
+}
@@ -0,0 +1,78 @@
+#ifndef __SCC_EVENT_FILTER_H__
+#define __SCC_EVENT_FILTER_H__
+#include <linux/types.h>
+
+struct task_struct;
+struct event_filter;
+
+enum event_filter_kind
+{
+    EVENT_FILTER_SYSCALL,
+    EVENT_FILTER_TGID,
+    EVENT_FILTER_UID,
+    EVENT_FILTER_COMM,
+};
+
+/**
+ * @brief Decide whether the syscall @nr of @task passes @filter, see struct scc_config.
+ *
+ * Evaluated before any capture work, so it only reads the filter tables and @task.
+ * The consumers of /dev/scc are left to event_filter_consumer().
+ *
+ * ! Must be called under rcu_read_lock(), @filter belongs to the configuration in effect.
+ *
+ * @return true to capture the event, false to drop it. A NULL @filter captures everything.
+ */
+bool event_filter_match(const struct event_filter *filter, long nr, const struct task_struct *task);
+
+/**
+ * @brief Replace the include or exclude table of @kind.
+ *
+ * @param list Comma separated syscalls (bitmap_parselist() syntax), tgids, uids
+ *             or comm prefixes. An empty list clears the table.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int event_filter_set(enum event_filter_kind kind, bool exclude, const char *list);
+
+/**
+ * @brief Build a copy of @old with the include or exclude table of @kind replaced.
+ *
+ * For filters kept outside of struct scc_config, see event_consumer.h.
+ *
+ * @return The new filter, NULL if it filters nothing, ERR_PTR() otherwise.
+ */
+struct event_filter *event_filter_update(const struct event_filter *old, enum event_filter_kind kind, bool exclude, const char *list);
+
+/**
+ * @brief Free @filter once no reader can see it anymore, NULL is ignored.
+ */
+void event_filter_free(struct event_filter *filter);
+
+/**
+ * @brief Remove every filter, except the automatic consumer exclusion.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int event_filter_clear(void);
+
+/**
+ * @brief Whether @task belongs to a process reading /dev/scc.
+ *
+ * Those are never traced, otherwise their own reads would generate events in a feedback loop.
+ */
+bool event_filter_consumer(const struct task_struct *task);
+
+/**
+ * @brief Exclude the process @tgid, once per open file, a process takes a single slot.
+ *
+ * @return 0 on success, -ENOSPC if FILTER_CONSUMERS_MAX processes already read.
+ */
+int event_filter_add_consumer(pid_t tgid);
+
+/**
+ * @brief Undo a successful event_filter_add_consumer(), never fails.
+ */
+void event_filter_remove_consumer(pid_t tgid);
+
+#endif // __SCC_EVENT_FILTER_H__
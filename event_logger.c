@@ -1,20 +1,29 @@
-#include <linux/circ_buf.h>
 #include <linux/linkage.h>
 #include <linux/mm.h>
 #include <linux/cred.h>   /* For current_uid() */
 #include <linux/uidgid.h> /* For __kuid_val() */
 #include <linux/sched.h>
 #include <linux/ptrace.h>
-#include <asm-generic/syscall.h>
+#include <asm/syscall.h>
 #include <linux/version.h>
-#include <linux/atomic.h>
-#include <linux/hashtable.h>
-#include <linux/hash.h>
 #include <linux/sched/task_stack.h>
-#include <linux/completion.h>
-#include <linux/mutex.h>
+#include <linux/unistd.h>
+#include <linux/rcupdate.h>
+#include <linux/debugfs.h>
 
 #include "event_logger.h"
+#include "event_config.h"
+#include "event_cache.h"
+#include "event_filter.h"
+#include "event_prog.h"
+#include "event_sample.h"
+#include "event_strings.h"
+#include "syscall_stats.h"
+#include "event_pool.h"
+#include "event_ring.h"
+#include "event_consumer.h"
+#include "event_stats.h"
+#include "event_record.h"
 #include "event_schema.h"
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 1, 0)
@@ -27,276 +36,344 @@ static_assert(sizeof(struct scc_syscall_info) == sizeof(struct syscall_info),
               "The size of struct scc_syscall_info is not the same as struct syscall_info.");
 #endif
 
-#define CIRC_BUFFER_SIZE (PAGE_SIZE << 2)
-static char page_buffer[CIRC_BUFFER_SIZE];
-static struct circ_buf log_circ_buffer = {
-    .buf = page_buffer,
-    .head = 0,
-    .tail = 0,
-};
-static struct completion buffer_completion;
-static DEFINE_MUTEX(buffer_lock);
-
-// hash map for caching events before the log_event() call
-static DEFINE_HASHTABLE(event_cache, 8);
-static struct completion event_cache_completion;
-static DEFINE_MUTEX(event_cache_lock);
-
-#define lock_completion(comp, lock) \
-    do                              \
-    {                               \
-        if (mutex_trylock(lock))    \
-            break;                  \
-        wait_for_completion(comp);  \
-    } while (1)
-
-#define unlock_completion(comp, lock) \
-    do                                \
-    {                                 \
-        mutex_unlock(lock);           \
-        complete(comp);               \
-    } while (0)
-
-static inline void log_event(const struct event *event);
-static inline void drop_last_event(void);
-static inline void init_event_cache(void);
-static inline void cache_event(const struct event *event);
-static inline long long get_event_cache_hash_key(const struct event *event);
+static inline bool cache_event(const struct event *event, bool strings);
 static inline int get_current_event(struct event *event);
-static atomic_t enable_event_logger_flag = ATOMIC_INIT(0);
-static __always_inline int is_event_logger_enabled(void)
-{
-    // atomic_read(&enable_event_logger_flag) == 0 means the event logger is not enabled
-    return atomic_read(&enable_event_logger_flag);
-}
-static inline void clear_log_circ_buffer(void);
-static inline void clear_event_cache(void);
+static struct dentry *debugfs_dir = NULL;
 
-noinline asmlinkage void event_logger(void)
+// whether an event was captured and left in the cache for the exit
+static inline bool capture_syscall_entry(const struct scc_config *config, long nr)
 {
-    if (unlikely(!is_event_logger_enabled()))
-        return;
-
-    init_event_cache();
+    // bound the work done for a syscall storm, the weight tells how many syscalls were skipped
+    const u32 weight = event_sample(config, nr, current->tgid);
+    if (weight == 0)
+    {
+        event_stats_inc(EVENT_STAT_SAMPLED);
+        return false;
+    }
 
     struct event event;
+    const u64 start = event_stats_begin();
     int rc = get_current_event(&event);
+    event_stats_end(EVENT_STAGE_CAPTURE, start);
     if (rc < 0)
     {
         printk(KERN_ERR "Failed to get the current event event_logger(void)\n");
-        return;
+        return false;
     }
 
-    cache_event(&event);
+    event.weight = weight;
+    const enum event_prog_verdict verdict = event_prog_run(config->prog, &event.info.data, NULL, &event.weight);
+    if (verdict == EVENT_PROG_DROP)
+    {
+        event_stats_inc(EVENT_STAT_PROG_DROPPED);
+        return false;
+    }
+    event.flags = verdict == EVENT_PROG_DEFER ? EVENT_FLAG_PROG_DEFERRED : 0;
+    if (config->latency)
+        event.flags |= EVENT_FLAG_LATENCY;
+
+    const bool strings = nr >= 0 && nr < HOOK_NR_SYSCALLS && test_bit(nr, config->strings) && syscall_has_strings(nr);
+    return cache_event(&event, strings);
 }
 
-void post_event_logger(void)
+// park a bare event that only holds the entry time of the syscall @nr
+static inline bool time_syscall_entry(long nr)
 {
-    int sysret;
-    if (unlikely(!is_event_logger_enabled()))
-        return;
-// get system call return value, by x86 syscall convention, it is stored in rax
-// we use inline asm to get the return value from rax/eax to sysret
-#if defined(__i386__)
-    asm volatile("mov %%rax, %0"
-                 : "=r"(sysret));
-#elif defined(__x86_64__)
-    asm volatile("mov %%eax, %0"
-                 : "=r"(sysret));
-#else
-#error "Unsupported architecture currently"
-#endif
-    // The condition that the event is not cached is very rare, so we don't need to optimize it
-    init_event_cache();
+    struct event *timed = event_pool_alloc();
+    if (unlikely(!timed))
+        return false;
 
-    struct event cur_event;
-    int rc = get_current_event(&cur_event);
-    if (rc < 0)
+    const struct event event = {
+        .task = current,
+        .info.data.nr = nr,
+        .flags = EVENT_FLAG_LATENCY | EVENT_FLAG_TIMED,
+        .weight = 1,
+    };
+    event_cache_fill(timed, &event);
+    timed->tstamp = ktime_get();
+    return event_cache_insert(timed);
+}
+
+// whether an event is left in the cache for the exit
+static inline bool log_syscall_entry(const struct scc_config *config)
+{
+    if (unlikely(!config->enabled))
+        return false;
+    // only readers get events, aggregate mode counts everything at exit once the return value is known
+    const bool capture = config->mode == EVENT_LOGGER_EVENTS && !event_consumers_empty();
+    if (!capture && !config->latency)
+        return false;
+
+    // decide before doing any capture work, most syscalls are usually filtered out
+    const long nr = syscall_get_nr(current, task_pt_regs(current));
+    // they never return, there is nothing to pair the event with
+    if (unlikely(nr == __NR_exit || nr == __NR_exit_group))
+        return false;
+    if (event_filter_consumer(current) || !event_filter_match(config->filter, nr, current))
     {
-        printk(KERN_WARNING "Failed to get the cached event event_logger(void)\n");
-        return;
+        event_stats_inc(EVENT_STAT_FILTERED);
+        return false;
     }
 
-    long long key = get_event_cache_hash_key(&cur_event);
-    if (unlikely(key < 0))
+    if (capture && capture_syscall_entry(config, nr))
+        return true;
+    // every syscall that passes the filter tables is timed, whether it is captured or not
+    return config->latency && time_syscall_entry(nr);
+}
+
+static inline void log_syscall_exit(const struct scc_config *config, long sysret, enum event_entry entry)
+{
+    if (unlikely(!config->enabled))
         return;
-    struct event *cached_event = NULL;
 
-    lock_completion(&event_cache_completion, &event_cache_lock);
-    // find the cached event from event_cache(hash table)
-    hash_for_each_possible(event_cache, cached_event, node, key)
+    // no event at all, the syscall number is still in orig_ax
+    const bool aggregate = config->mode == EVENT_LOGGER_AGGREGATE;
+    if (aggregate)
     {
-        if (cached_event->task == cur_event.task &&
-            cached_event->info.data.nr == cur_event.info.data.nr &&
-            cached_event->info.data.instruction_pointer == cur_event.info.data.instruction_pointer)
-        {
-            // found the cached event, unplugged it from the hash table
-            hash_del(&cached_event->node);
-            break;
-        }
+        const long nr = syscall_get_nr(current, task_pt_regs(current));
+        if (!event_filter_consumer(current) && event_filter_match(config->filter, nr, current))
+            syscall_stats_account(nr, sysret);
+        if (!config->latency)
+            return;
     }
-    unlock_completion(&event_cache_completion, &event_cache_lock);
 
+    // dropped at entry, there is nothing to take
+    if (entry == EVENT_ENTRY_NONE || (entry == EVENT_ENTRY_UNKNOWN && event_consumers_empty() && !config->latency))
+        return;
+
+    // a task has at most one syscall in flight, so the task alone finds its event
+    const u64 start = event_stats_begin();
+    struct event *cached_event = event_cache_take(current);
+    event_stats_end(EVENT_STAGE_CACHE_TAKE, start);
     if (unlikely(!cached_event)) // not found in cache, no longer need to log
+    {
+        // only a miss if the entry is known to have left one, it was evicted meanwhile
+        if (entry == EVENT_ENTRY_CACHED)
+            event_stats_inc(EVENT_STAT_EXIT_MISSED);
+        return;
+    }
+
+    // dropped at entry, and this one is left behind by a previous syscall
+    if (unlikely(cached_event->info.data.nr != syscall_get_nr(current, task_pt_regs(current))))
+    {
+        event_stats_inc(EVENT_STAT_EXIT_STALE);
+        event_pool_free(cached_event);
         return;
+    }
+
+    // every syscall is measured on its own, so the weight of a captured event does not apply
+    const ktime_t now = ktime_get();
+    u64 duration = 0;
+    if (cached_event->flags & EVENT_FLAG_LATENCY)
+    {
+        duration = ktime_to_ns(ktime_sub(now, cached_event->tstamp));
+        // parked before latency was turned off, the histograms may be being reset
+        if (config->latency)
+            syscall_stats_account_latency(cached_event->info.data.nr, duration);
+    }
+    // nothing to push, or captured right before the switch to aggregate mode
+    if ((cached_event->flags & EVENT_FLAG_TIMED) || aggregate)
+    {
+        event_pool_free(cached_event);
+        return;
+    }
+
     cached_event->ret = sysret;
 
+    if (cached_event->flags & EVENT_FLAG_PROG_DEFERRED)
+    {
+        const uint64_t ret = cached_event->ret;
+        const enum event_prog_verdict verdict = event_prog_run(config->prog, &cached_event->info.data, &ret, &cached_event->weight);
+        if (verdict != EVENT_PROG_KEEP)
+        {
+            event_stats_inc(EVENT_STAT_PROG_DROPPED);
+            event_pool_free(cached_event);
+            return;
+        }
+    }
+
     // set the timestamp
-    cached_event->tstamp = ktime_get();
-
-    // lock the buffer
-    lock_completion(&buffer_completion, &buffer_lock);
-    log_event(cached_event);
-    unlock_completion(&buffer_completion, &buffer_lock);
-
-    kfree(cached_event);
-
-#if defined(__i386__)
-    asm volatile("mov %0, %%rax"
-                 :
-                 : "r"(sysret)); // restore the return value
-#elif defined(__x86_64__)
-    asm volatile("mov %%eax, %0"
-                 : "=r"(sysret));
-#else
-#error "Unsupported architecture currently"
-#endif
+    struct event_record record = {0};
+    record.duration = duration;
+    cached_event->tstamp = now;
+
+    event_to_schema(cached_event, &record.schema);
+    record.weight = cached_event->weight;
+    const struct event_strings *strings = NULL;
+    if (cached_event->flags & EVENT_FLAG_STRINGS)
+    {
+        strings = event_strings_of(cached_event);
+        record.nr_strings = strings->nr;
+    }
+    event_stats_inc(EVENT_STAT_CAPTURED);
+    const u64 push_start = event_stats_begin();
+    event_consumers_push(&record, strings);
+    event_stats_end(EVENT_STAGE_PUSH, push_start);
+
+    event_pool_free(cached_event);
 }
 
-int asmlinkage get_event(struct event *event)
+// a whole syscall entry or exit sees one configuration, updates never wait for it
+noinline asmlinkage enum event_entry event_logger(void)
 {
-    if (unlikely(!is_event_logger_enabled()))
-        return -ENODATA;
-    if (unlikely(log_circ_buffer.head == log_circ_buffer.tail))
-        return -ENODATA;
-    if (unlikely(!event))
-        return -EINVAL;
-    init_event_cache();
+    const u64 start = event_stats_begin();
+    rcu_read_lock();
+    const bool cached = log_syscall_entry(event_config_get());
+    rcu_read_unlock();
+    event_stats_end(EVENT_STAGE_ENTRY, start);
+    return cached ? EVENT_ENTRY_CACHED : EVENT_ENTRY_NONE;
+}
 
-    lock_completion(&buffer_completion, &buffer_lock);
-    if (log_circ_buffer.head != log_circ_buffer.tail)
-    {
-        memcpy(event, log_circ_buffer.buf + log_circ_buffer.tail, sizeof(struct event));
-        log_circ_buffer.tail = (log_circ_buffer.tail + sizeof(struct event)) & (CIRC_BUFFER_SIZE - 1);
-    }
-    unlock_completion(&buffer_completion, &buffer_lock);
+void post_event_logger(long sysret, enum event_entry entry)
+{
+    const u64 start = event_stats_begin();
+    rcu_read_lock();
+    log_syscall_exit(event_config_get(), sysret, entry);
+    rcu_read_unlock();
+    event_stats_end(EVENT_STAGE_EXIT, start);
+}
+
+int event_logger_init(void)
+{
+    int rc = event_pool_init();
+    if (rc < 0)
+        return rc;
+
+    // debugfs is optional, the files are simply missing without it
+    debugfs_dir = debugfs_create_dir("scc", NULL);
+    rc = syscall_stats_init(debugfs_dir);
+    if (rc < 0)
+        goto failed_stats;
+    event_stats_init(debugfs_dir);
     return 0;
+
+failed_stats:
+    debugfs_remove_recursive(debugfs_dir);
+    event_pool_exit();
+    return rc;
 }
 
-int asmlinkage get_events(struct event *restrict events, int *restrict size, int capacity)
+void event_logger_exit(void)
 {
-    if (unlikely(!is_event_logger_enabled()))
-        return -ENODATA;
-    if (unlikely(!events || !size || capacity <= 0))
+    enable_event_logger(0);
+    event_config_exit();
+    debugfs_remove_recursive(debugfs_dir);
+    syscall_stats_exit();
+    event_pool_exit();
+}
+
+int asmlinkage get_event(struct event_consumer *consumer, struct event_record *record)
+{
+    if (unlikely(!record))
         return -EINVAL;
-    if (unlikely(log_circ_buffer.head == log_circ_buffer.tail))
+
+    if (event_rings_pop(consumer->rings, record, NULL, 1) == 0)
         return -ENODATA;
-    init_event_cache();
+    return 0;
+}
 
-    int i = 0;
-    lock_completion(&buffer_completion, &buffer_lock);
-    while (log_circ_buffer.head != log_circ_buffer.tail && i < capacity)
-    {
-        memcpy(events + i, log_circ_buffer.buf + log_circ_buffer.tail, sizeof(struct event));
-        log_circ_buffer.tail = (log_circ_buffer.tail + sizeof(struct event)) & (CIRC_BUFFER_SIZE - 1);
-        i++;
-    }
-    unlock_completion(&buffer_completion, &buffer_lock);
+int asmlinkage get_events(struct event_consumer *consumer, struct event_record *restrict records, struct event_strings *restrict strings, int *restrict size, int capacity)
+{
+    if (unlikely(!records || !size || capacity <= 0))
+        return -EINVAL;
 
-    *size = i;
+    const u64 start = event_stats_begin();
+    *size = event_rings_pop(consumer->rings, records, strings, capacity);
+    event_stats_end(EVENT_STAGE_READ, start);
+    if (unlikely(*size == 0))
+        return -ENODATA;
     return 0;
 }
 
-void asmlinkage enable_event_logger(int enable)
+int asmlinkage enable_event_logger(int enable)
 {
     if (unlikely(enable != 0 && enable != 1))
-        return;
-    atomic_set(&enable_event_logger_flag, enable);
+        return -EINVAL;
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+    config->enabled = enable;
+    event_config_publish(config);
+
     // when disable the event logger, we need to clear the buffer
     if (enable == 0)
     {
-        clear_log_circ_buffer();
-        clear_event_cache();
+        // no syscall may still be logging with the old configuration
+        synchronize_rcu();
+        event_consumers_clear();
+        event_cache_clear();
     }
+    return 0;
 }
 
-void event_to_schema(const struct event *event, struct event_schema *schema)
-{
-    if (unlikely(!event || !schema))
-        return;
-
-#define GET_DATA_SAFE(ptr, member) ((ptr) ? (ptr)->member : 0)
-    schema->uid = __kuid_val(event->cred->uid);
-    schema->pid = GET_DATA_SAFE(event->task, pid);
-    schema->ppid = GET_DATA_SAFE(event->task->real_parent, pid);
-    schema->tid = GET_DATA_SAFE(event->task, tgid);
-    schema->timestamp = ktime_to_ns(event->tstamp);
-
-    schema->syscall_nr = event->info.data.nr;
-    memcpy(schema->syscall_args, event->info.data.args, sizeof(schema->syscall_args));
-    schema->syscall_ret = event->ret;
-#undef GET_DATA_SAFE
-}
-
-static inline void log_event(const struct event *event)
+int set_event_logger_mode(enum event_logger_mode mode)
 {
-    if (CIRC_SPACE(log_circ_buffer.head, log_circ_buffer.tail, CIRC_BUFFER_SIZE) >= sizeof(struct event))
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+    const bool entering = mode == EVENT_LOGGER_AGGREGATE && config->mode != EVENT_LOGGER_AGGREGATE;
+    if (entering)
     {
-        memcpy(log_circ_buffer.buf + log_circ_buffer.head, event, sizeof(struct event));
-        log_circ_buffer.head = (log_circ_buffer.head + sizeof(struct event)) & (CIRC_BUFFER_SIZE - 1);
+        // only aggregate mode counts, once the syscalls of the last one are gone nobody does
+        synchronize_rcu();
+        syscall_stats_clear();
     }
-    else
+    config->mode = mode;
+    event_config_publish(config);
+
+    // their exit takes nothing from the cache without latency, do not leave them behind
+    if (entering)
     {
-        drop_last_event();
-        log_event(event);
+        synchronize_rcu();
+        event_cache_clear();
     }
+    return 0;
 }
 
-static inline void drop_last_event(void)
-{
-    // drop the tail
-    log_circ_buffer.tail = (log_circ_buffer.tail + sizeof(struct event)) & (CIRC_BUFFER_SIZE - 1);
-}
-
-static inline void init_event_cache(void)
+int set_event_logger_latency(bool enable)
 {
-    static atomic_t initialized = ATOMIC_INIT(0);
-    if (atomic_xchg(&initialized, 1))
-        return;
-
-    hash_init(event_cache);
-
-    init_completion(&event_cache_completion);
-    init_completion(&buffer_completion);
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+    if (enable && !config->latency)
+    {
+        // nobody measures while latency is off, once the syscalls that did are gone
+        synchronize_rcu();
+        syscall_stats_clear_latency();
+    }
+    config->latency = enable;
+    event_config_publish(config);
+    return 0;
 }
 
-static inline void cache_event(const struct event *event)
+static inline bool cache_event(const struct event *event, bool strings)
 {
-    struct event *cached_event = kmalloc(sizeof(struct event), GFP_KERNEL);
+    // never sleep in the syscall path, drop the event if the pool is exhausted
+    struct event *cached_event = strings ? event_pool_alloc_strings() : NULL;
+    // better an event without its strings than none
+    if (!cached_event)
+    {
+        if (strings)
+            event_stats_inc(EVENT_STAT_STRINGS_FAILED);
+        cached_event = event_pool_alloc();
+    }
+    // counted by the pool
     if (unlikely(!cached_event))
-        return;
+        return false;
 
-    memcpy(cached_event, event, sizeof(struct event));
-    long long key = get_event_cache_hash_key(event);
-    if (unlikely(key < 0))
-        return;
+    event_cache_fill(cached_event, event);
 
-    lock_completion(&event_cache_completion, &event_cache_lock);
-    hash_add(event_cache, &cached_event->node, key);
-    unlock_completion(&event_cache_completion, &event_cache_lock);
-}
+    // read now, the memory they are in may be gone or reused by the time the syscall returns
+    if (cached_event->flags & EVENT_FLAG_STRINGS)
+        event_strings_capture(cached_event->info.data.nr, cached_event->info.data.args, event_strings_of(cached_event));
+    // as late as possible, the capture work above is not part of the syscall
+    if (cached_event->flags & EVENT_FLAG_LATENCY)
+        cached_event->tstamp = ktime_get();
 
-static inline long long get_event_cache_hash_key(const struct event *event)
-{
-    if (unlikely(!event))
-        return -EINVAL;
-    // same task, same syscall, same instruction pointer, is the same event
-    const long long tmp = (long long)event->task + (long long)event->info.data.nr + (long long)event->info.data.instruction_pointer;
-
-    // unset the MSB, we reserve it for invalid result in the future
-#define MSB (1ULL << (sizeof(long long) * 8 - 1))
-    return tmp & ~MSB;
-#undef MSB
+    const u64 start = event_stats_begin();
+    const bool cached = event_cache_insert(cached_event);
+    event_stats_end(EVENT_STAGE_CACHE_INSERT, start);
+    return cached;
 }
 
 static inline int get_current_event(struct event *event)
@@ -304,9 +381,17 @@ static inline int get_current_event(struct event *event)
     if (unlikely(!event))
         return -EINVAL;
 
+    // snapshot the identity while these lines are hot, the read path never touches the task
+    rcu_read_lock();
+    const pid_t ppid = rcu_dereference(current->real_parent)->pid;
+    rcu_read_unlock();
+
     *event = (struct event){
         .task = current,
-        .cred = current_cred(),
+        .pid = current->pid,
+        .tgid = current->tgid,
+        .ppid = ppid,
+        .uid = __kuid_val(current_uid()),
         .info = {
             .sp = 0,
             .data = {
@@ -340,25 +425,3 @@ static inline int get_current_event(struct event *event)
 
     return 0;
 }
-
-static inline void clear_log_circ_buffer(void)
-{
-    lock_completion(&buffer_completion, &buffer_lock);
-
-    log_circ_buffer.head = log_circ_buffer.tail = 0;
-    unlock_completion(&buffer_completion, &buffer_lock);
-}
-
-static inline void clear_event_cache(void)
-{
-    lock_completion(&event_cache_completion, &event_cache_lock);
-    struct event *to_be_deleted;
-    struct hlist_node *tmp;
-    long bkt;
-    hash_for_each_safe(event_cache, bkt, tmp, to_be_deleted, node)
-    {
-        hash_del(&to_be_deleted->node);
-        kfree(to_be_deleted);
-    }
-    unlock_completion(&event_cache_completion, &event_cache_lock);
-}
\ No newline at end of file
@@ -2,10 +2,12 @@
 #define __SCC_event_logger_H__
 #include <linux/types.h>
 #include <linux/time.h>
+#include <linux/llist.h>
 
 struct task_struct;
-struct cred;
-struct event_schema;
+struct event_record;
+struct event_strings;
+struct event_consumer;
 
 // Because of compatibility issues, we need to define the struct similar to the kernel version.
 struct scc_seccomp_data
@@ -20,60 +22,138 @@ struct scc_syscall_info
     uint64_t sp;
     struct scc_seccomp_data data;
 };
+// the filter program needs the return value, decide at exit
+#define EVENT_FLAG_PROG_DEFERRED 0x1
+// tstamp holds the entry time
+#define EVENT_FLAG_LATENCY 0x2
+// the event comes with a struct event_strings, see event_pool_alloc_strings()
+#define EVENT_FLAG_STRINGS 0x4
+// nothing was captured, the event only times the syscall for the latency histograms
+#define EVENT_FLAG_TIMED 0x8
+
 struct event
 {
-    struct task_struct *task;
-    const struct cred *cred;
+    // the key of the event cache, only compared and never dereferenced
+    const struct task_struct *task;
     struct scc_syscall_info info;
     union
     {
         unsigned long ret;
-        struct hlist_node node;
+        struct llist_node free_node;
     };
+    // the entry time while measuring latency, then the exit time
     ktime_t tstamp;
-    // reserved for future use, and align to 128 bytes
-    // must align to the power of 2
-    unsigned long reserved[2];
+    // the CPU whose event pool owns this event
+    unsigned int pool_cpu;
+    // EVENT_FLAG_*, keeps the struct aligned to 128 bytes
+    unsigned int flags;
+    // identity of the task snapshotted at entry, the task may be gone by the time the event is read
+    pid_t pid;
+    pid_t tgid;
+    pid_t ppid;
+    uid_t uid;
+    // the number of syscalls this event stands for after sampling
+    unsigned int weight;
+    // the low bits of jiffies when the event entered the event cache, the oldest one is evicted first.
+    // Last, like task it is read by other CPUs, see event_cache_fill()
+    unsigned int cached_at;
+};
+
+enum event_logger_mode
+{
+    // every syscall becomes an event in the rings
+    EVENT_LOGGER_EVENTS,
+    // only count the syscalls per number, see syscall_stats.h
+    EVENT_LOGGER_AGGREGATE,
 };
 
-void event_logger(void);
+/**
+ * @brief Allocate the per-CPU event pools, must be called before hooking.
+ *
+ * @return 0 on success, non-zero otherwise.
+ */
+int event_logger_init(void);
 
-// catch the return value of the original syscall
-void post_event_logger(void);
+void event_logger_exit(void);
+
+// what the entry of a syscall left for its exit
+enum event_entry
+{
+    // no event cached, the exit has nothing to take
+    EVENT_ENTRY_NONE,
+    EVENT_ENTRY_CACHED,
+    // the caller cannot carry the entry to the exit, like the tracepoint probes
+    EVENT_ENTRY_UNKNOWN,
+};
+
+enum event_entry event_logger(void);
 
 /**
- * @brief Get the last event from the event log.
+ * @brief Catch the return value of the original syscall.
  *
- * @param event The event to store the event in.
+ * @param entry What event_logger() returned at the entry of this syscall.
+ */
+void post_event_logger(long sysret, enum event_entry entry);
+
+/**
+ * @brief Get the last event queued for @consumer.
+ *
+ * @param record The record to store the event in.
  *
- * @return 0 if an event was read, non-zero otherwise.
+ * @return 0 if an event was read, -ENODATA if nothing is queued.
  *
- * ! Blocking the current thread until an event is read.
+ * Never blocks, see event_rings_wait() on the rings of @consumer to wait for events. What is
+ * queued is read even once the logger is disabled, until disabling drops it.
  */
-int get_event(struct event *event);
+int get_event(struct event_consumer *consumer, struct event_record *record);
 
 /**
- * @brief Get up to `capacity` events from the event log.
+ * @brief Get up to `capacity` events queued for @consumer.
  *
- * @param events The array to store the events in.
+ * @param records The array to store the events in.
+ * @param strings The array to store the strings of the events in, may be NULL.
  * @param size The number of events read.
  * @param capacity The maximum number of events to read.
  *
- * @return 0 if events were read, non-zero otherwise.
+ * @return 0 if events were read, -ENODATA if nothing is queued.
  *
- * ! Blocking the current thread until min(capacity, number of events) events are read.
+ * Never blocks, see event_rings_wait() on the rings of @consumer to wait for events. What is
+ * queued is read even once the logger is disabled, until disabling drops it.
  */
-int get_events(struct event *restrict events, int *restrict size, int capacity);
+int get_events(struct event_consumer *consumer, struct event_record *restrict records, struct event_strings *restrict strings, int *restrict size, int capacity);
 
 /**
  * @brief Enable or disable the event logger.
  *
  * @param enable 1 to enable, 0 to disable.
  *
- * Do nothing if @enable is not 0 or 1.
+ * Disabling waits for the syscalls being logged, then drops everything queued.
+ *
+ * @return 0 on success, -EINVAL if @enable is not 0 or 1, -ENOMEM otherwise.
+ */
+int enable_event_logger(int enable);
+
+/**
+ * @brief Switch between capturing events and only counting syscalls.
+ *
+ * Entering aggregate mode zeroes the counters, then drops the in-flight events. The reset
+ * waits for the syscalls still counting with a previous aggregate mode, so it never races
+ * with them. Staying in aggregate mode keeps counting.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
  */
-void enable_event_logger(int enable);
+int set_event_logger_mode(enum event_logger_mode mode);
 
-void event_to_schema(const struct event *event, struct event_schema *schema);
+/**
+ * @brief Measure how long the hooked syscalls that pass the filter tables take.
+ *
+ * Every such syscall is timed once, in both modes and whether it is captured or not.
+ * The durations feed per-syscall histograms, see syscall_stats.h, and are attached
+ * to the records as `duration`. Turning it on zeroes the histograms, once the syscalls
+ * measured before are gone.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int set_event_logger_latency(bool enable);
 
 #endif
\ No newline at end of file
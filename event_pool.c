@@ -0,0 +1,141 @@
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/llist.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/topology.h>
+
+#include "event_logger.h"
+#include "event_pool.h"
+#include "event_schema.h"
+#include "event_stats.h"
+
+/* The number of in-flight syscalls each CPU can track, sized at load time.
+ * A syscall blocked in the kernel keeps its event until it returns.
+ */
+static unsigned int pool_size = 1024;
+module_param(pool_size, uint, 0444);
+// the number of those that can also hold the strings of their syscall
+static unsigned int strings_pool_size = 64;
+module_param(strings_pool_size, uint, 0444);
+
+struct string_event
+{
+    struct event event;
+    struct event_strings strings;
+};
+
+/**
+ * @brief Per-CPU free list of events.
+ *
+ * Only the owning CPU takes events out of @free, with preemption disabled,
+ * while any CPU may give them back, which is what llist is safe for without a lock.
+ * The same goes for @free_strings.
+ */
+struct event_pool
+{
+    struct llist_head free;
+    struct event *objs;
+    struct llist_head free_strings;
+    struct string_event *string_objs;
+};
+
+static DEFINE_PER_CPU(struct event_pool, event_pools);
+
+int event_pool_init(void)
+{
+    if (pool_size == 0)
+    {
+        printk(KERN_ERR "Invalid event pool size %u\n", pool_size);
+        return -EINVAL;
+    }
+
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct event_pool *pool = per_cpu_ptr(&event_pools, cpu);
+        init_llist_head(&pool->free);
+        init_llist_head(&pool->free_strings);
+        pool->objs = kvmalloc_node(array_size(pool_size, sizeof(struct event)), GFP_KERNEL, cpu_to_node(cpu));
+        pool->string_objs = kvmalloc_node(array_size(strings_pool_size, sizeof(struct string_event)), GFP_KERNEL, cpu_to_node(cpu));
+        if (!pool->objs || (strings_pool_size && !pool->string_objs))
+        {
+            printk(KERN_ERR "Failed to allocate the event pool of cpu %d\n", cpu);
+            event_pool_exit();
+            return -ENOMEM;
+        }
+
+        for (unsigned int i = 0; i < pool_size; ++i)
+        {
+            pool->objs[i].pool_cpu = cpu;
+            pool->objs[i].flags = 0;
+            llist_add(&pool->objs[i].free_node, &pool->free);
+        }
+        for (unsigned int i = 0; i < strings_pool_size; ++i)
+        {
+            pool->string_objs[i].event.pool_cpu = cpu;
+            pool->string_objs[i].event.flags = EVENT_FLAG_STRINGS;
+            llist_add(&pool->string_objs[i].event.free_node, &pool->free_strings);
+        }
+    }
+    return 0;
+}
+
+void event_pool_exit(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct event_pool *pool = per_cpu_ptr(&event_pools, cpu);
+        init_llist_head(&pool->free);
+        init_llist_head(&pool->free_strings);
+        kvfree(pool->objs);
+        kvfree(pool->string_objs);
+        pool->objs = NULL;
+        pool->string_objs = NULL;
+    }
+}
+
+struct event *event_pool_alloc(void)
+{
+    struct event *event = NULL;
+
+    preempt_disable();
+    struct event_pool *pool = this_cpu_ptr(&event_pools);
+    struct llist_node *node = llist_del_first(&pool->free);
+    if (likely(node))
+        event = llist_entry(node, struct event, free_node);
+    else
+        event_stats_inc(EVENT_STAT_ALLOC_FAILED);
+    preempt_enable();
+
+    return event;
+}
+
+struct event *event_pool_alloc_strings(void)
+{
+    struct event *event = NULL;
+
+    preempt_disable();
+    struct llist_node *node = llist_del_first(&this_cpu_ptr(&event_pools)->free_strings);
+    if (likely(node))
+        event = llist_entry(node, struct event, free_node);
+    preempt_enable();
+
+    return event;
+}
+
+struct event_strings *event_strings_of(struct event *event)
+{
+    return &container_of(event, struct string_event, event)->strings;
+}
+
+void event_pool_free(struct event *event)
+{
+    if (unlikely(!event))
+        return;
+    struct event_pool *pool = per_cpu_ptr(&event_pools, event->pool_cpu);
+    llist_add(&event->free_node, event->flags & EVENT_FLAG_STRINGS ? &pool->free_strings : &pool->free);
+}
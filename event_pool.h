@@ -0,0 +1,49 @@
+#ifndef __SCC_EVENT_POOL_H__
+#define __SCC_EVENT_POOL_H__
+
+struct event;
+struct event_strings;
+
+/**
+ * @brief Preallocate `pool_size` events for every possible CPU.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int event_pool_init(void);
+
+void event_pool_exit(void);
+
+/**
+ * @brief Take an event from the pool of the current CPU.
+ *
+ * Never sleeps and never falls back to the general allocator.
+ *
+ * @return The event, or NULL if the pool is exhausted, which is counted as EVENT_STAT_ALLOC_FAILED.
+ *
+ * ! The `pool_cpu` member of the event must not be overwritten.
+ */
+struct event *event_pool_alloc(void);
+
+/**
+ * @brief Take an event with room for the strings of its arguments from the current CPU.
+ *
+ * Such events are fewer, they are flagged with EVENT_FLAG_STRINGS, see event_strings_of().
+ * Never sleeps and never falls back to the general allocator.
+ *
+ * @return The event, or NULL if they are all in flight.
+ *
+ * ! The `pool_cpu` member and the EVENT_FLAG_STRINGS flag must not be overwritten.
+ */
+struct event *event_pool_alloc_strings(void);
+
+/**
+ * @brief The strings of an event flagged with EVENT_FLAG_STRINGS.
+ */
+struct event_strings *event_strings_of(struct event *event);
+
+/**
+ * @brief Give an event back to the pool it was taken from, from any CPU.
+ */
+void event_pool_free(struct event *event);
+
+#endif // __SCC_EVENT_POOL_H__
@@ -0,0 +1,239 @@
+#include <linux/slab.h>
+#include <linux/rcupdate.h>
+#include <linux/percpu.h>
+#include <linux/string.h>
+#include <linux/filter.h>
+#include <linux/minmax.h>
+
+#include "event_prog.h"
+#include "event_config.h"
+
+struct event_prog
+{
+    unsigned int len;
+    struct rcu_head rcu;
+    struct sock_filter insns[];
+};
+
+static DEFINE_PER_CPU(u32, sample_count);
+
+static inline enum event_prog_verdict sample(u32 k, u32 *weight)
+{
+    if (k <= 1)
+        return k ? EVENT_PROG_KEEP : EVENT_PROG_DROP;
+    // one in k on each CPU, good enough without sharing a counter between CPUs
+    if (this_cpu_inc_return(sample_count) % k)
+        return EVENT_PROG_DROP;
+    *weight = min_t(u64, (u64)*weight * k, U32_MAX);
+    return EVENT_PROG_KEEP;
+}
+
+static_assert(offsetof(struct event_prog_data, ret) == sizeof(struct scc_seccomp_data),
+              "The return value must follow the syscall data.");
+
+enum event_prog_verdict event_prog_run(const struct event_prog *prog, const struct scc_seccomp_data *data, const uint64_t *ret, u32 *weight)
+{
+    if (likely(!prog))
+        return EVENT_PROG_KEEP;
+
+    // the verifier made sure every load is in bounds and every jump goes forward to an instruction
+    u32 A = 0;
+    for (unsigned int pc = 0; pc < prog->len; ++pc)
+    {
+        const struct sock_filter *insn = prog->insns + pc;
+        const u32 k = insn->k;
+        switch (insn->code)
+        {
+        case BPF_LD | BPF_W | BPF_ABS:
+            if (k < sizeof(*data))
+                A = *(const u32 *)((const char *)data + k);
+            else if (ret)
+                A = *(const u32 *)((const char *)ret + k - sizeof(*data));
+            else
+                return EVENT_PROG_DEFER;
+            break;
+        case BPF_LD | BPF_IMM:
+            A = k;
+            break;
+        case BPF_ALU | BPF_ADD | BPF_K:
+            A += k;
+            break;
+        case BPF_ALU | BPF_SUB | BPF_K:
+            A -= k;
+            break;
+        case BPF_ALU | BPF_MUL | BPF_K:
+            A *= k;
+            break;
+        case BPF_ALU | BPF_DIV | BPF_K:
+            A /= k;
+            break;
+        case BPF_ALU | BPF_MOD | BPF_K:
+            A %= k;
+            break;
+        case BPF_ALU | BPF_AND | BPF_K:
+            A &= k;
+            break;
+        case BPF_ALU | BPF_OR | BPF_K:
+            A |= k;
+            break;
+        case BPF_ALU | BPF_XOR | BPF_K:
+            A ^= k;
+            break;
+        case BPF_ALU | BPF_LSH | BPF_K:
+            A <<= k;
+            break;
+        case BPF_ALU | BPF_RSH | BPF_K:
+            A >>= k;
+            break;
+        case BPF_ALU | BPF_NEG:
+            A = -A;
+            break;
+        case BPF_JMP | BPF_JA:
+            pc += k;
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_K:
+            pc += A == k ? insn->jt : insn->jf;
+            break;
+        case BPF_JMP | BPF_JGT | BPF_K:
+            pc += A > k ? insn->jt : insn->jf;
+            break;
+        case BPF_JMP | BPF_JGE | BPF_K:
+            pc += A >= k ? insn->jt : insn->jf;
+            break;
+        case BPF_JMP | BPF_JSET | BPF_K:
+            pc += A & k ? insn->jt : insn->jf;
+            break;
+        case BPF_RET | BPF_K:
+            return sample(k, weight);
+        case BPF_RET | BPF_A:
+            return sample(A, weight);
+        }
+    }
+
+    // unreachable, a verified program always ends with a ret
+    return EVENT_PROG_KEEP;
+}
+
+static int verify_prog(const struct sock_filter *insns, unsigned int len)
+{
+    if (len == 0 || len > EVENT_PROG_MAX_INSNS)
+        return -EINVAL;
+
+    for (unsigned int pc = 0; pc < len; ++pc)
+    {
+        const struct sock_filter *insn = insns + pc;
+        // how far a jump may go without leaving the program
+        const u32 remain = len - pc - 1;
+        switch (insn->code)
+        {
+        case BPF_LD | BPF_W | BPF_ABS:
+            if (insn->k % sizeof(u32) || insn->k > sizeof(struct event_prog_data) - sizeof(u32))
+                return -EINVAL;
+            break;
+        case BPF_ALU | BPF_DIV | BPF_K:
+        case BPF_ALU | BPF_MOD | BPF_K:
+            if (insn->k == 0)
+                return -EINVAL;
+            break;
+        case BPF_ALU | BPF_LSH | BPF_K:
+        case BPF_ALU | BPF_RSH | BPF_K:
+            if (insn->k >= 32)
+                return -EINVAL;
+            break;
+        case BPF_LD | BPF_IMM:
+        case BPF_ALU | BPF_ADD | BPF_K:
+        case BPF_ALU | BPF_SUB | BPF_K:
+        case BPF_ALU | BPF_MUL | BPF_K:
+        case BPF_ALU | BPF_AND | BPF_K:
+        case BPF_ALU | BPF_OR | BPF_K:
+        case BPF_ALU | BPF_XOR | BPF_K:
+        case BPF_ALU | BPF_NEG:
+        case BPF_RET | BPF_K:
+        case BPF_RET | BPF_A:
+            break;
+        case BPF_JMP | BPF_JA:
+            if (insn->k >= remain)
+                return -EINVAL;
+            break;
+        case BPF_JMP | BPF_JEQ | BPF_K:
+        case BPF_JMP | BPF_JGT | BPF_K:
+        case BPF_JMP | BPF_JGE | BPF_K:
+        case BPF_JMP | BPF_JSET | BPF_K:
+            if (insn->jt >= remain || insn->jf >= remain)
+                return -EINVAL;
+            break;
+        default:
+            return -EINVAL;
+        }
+    }
+
+    // jumps only go forward, so this is the only way out besides a ret
+    if (BPF_CLASS(insns[len - 1].code) != BPF_RET)
+        return -EINVAL;
+    return 0;
+}
+
+// "<len>,<code> <jt> <jf> <k>,...", the output of bpf_asm and tcpdump -ddd
+static struct event_prog *parse_prog(char *text)
+{
+    unsigned int len;
+    const char *token = strsep(&text, ",");
+    if (kstrtouint(strim((char *)token), 0, &len) || len == 0 || len > EVENT_PROG_MAX_INSNS)
+        return ERR_PTR(-EINVAL);
+
+    struct event_prog *prog = kzalloc(struct_size(prog, insns, len), GFP_KERNEL);
+    if (!prog)
+        return ERR_PTR(-ENOMEM);
+    prog->len = len;
+
+    for (unsigned int i = 0; i < len; ++i)
+    {
+        struct sock_filter *insn = prog->insns + i;
+        token = strsep(&text, ",");
+        if (!token || sscanf(token, "%hu %hhu %hhu %u", &insn->code, &insn->jt, &insn->jf, &insn->k) != 4)
+            goto invalid;
+    }
+    // trailing instructions do not match the length
+    if (text && *strim(text) != '\0')
+        goto invalid;
+    return prog;
+
+invalid:
+    kfree(prog);
+    return ERR_PTR(-EINVAL);
+}
+
+int event_prog_load(const char *text)
+{
+    struct event_prog *prog = NULL;
+    if (*text != '\0')
+    {
+        char *copy = kstrdup(text, GFP_KERNEL);
+        if (!copy)
+            return -ENOMEM;
+        prog = parse_prog(copy);
+        kfree(copy);
+        if (IS_ERR(prog))
+            return PTR_ERR(prog);
+
+        int rc = verify_prog(prog->insns, prog->len);
+        if (rc < 0)
+        {
+            kfree(prog);
+            return rc;
+        }
+    }
+
+    struct scc_config *config = event_config_edit();
+    if (!config)
+    {
+        kfree(prog);
+        return -ENOMEM;
+    }
+    struct event_prog *old = config->prog;
+    config->prog = prog;
+    event_config_publish(config);
+    if (old)
+        kfree_rcu(old, rcu);
+    return 0;
+}
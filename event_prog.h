@@ -0,0 +1,63 @@
+#ifndef __SCC_EVENT_PROG_H__
+#define __SCC_EVENT_PROG_H__
+#include <linux/types.h>
+
+#include "event_logger.h"
+
+// the longest program accepted, every instruction runs at most once
+#define EVENT_PROG_MAX_INSNS 128
+
+struct event_prog;
+
+/**
+ * @brief The data a program loads from, the same layout as seccomp filters plus the return value.
+ *
+ * Loads are 32-bit words like in seccomp, so a 64-bit argument is read as two words,
+ * the low one first on little endian.
+ */
+struct event_prog_data
+{
+    struct scc_seccomp_data data;
+    uint64_t ret;
+};
+
+enum event_prog_verdict
+{
+    EVENT_PROG_DROP,
+    EVENT_PROG_KEEP,
+    // the program needs the return value, run it again at exit
+    EVENT_PROG_DEFER,
+};
+
+/**
+ * @brief Run the filter program on a syscall.
+ *
+ * Programs are classic BPF over struct event_prog_data: a 32-bit accumulator, absolute
+ * word loads, immediates, ALU and conditional jumps with constant operands, and forward
+ * jumps only, so they always terminate. `ret k` drops the event if k is 0, keeps it if k
+ * is 1, and otherwise keeps one event in k.
+ *
+ * @param prog The program of the configuration in effect, NULL keeps everything.
+ * @param data The syscall number and arguments.
+ * @param ret The return value, NULL at entry. A program loading it at entry stops
+ *            there and returns EVENT_PROG_DEFER.
+ * @param weight The weight of the event, multiplied by k when `ret k` keeps it.
+ *
+ * ! Must be called under rcu_read_lock().
+ *
+ * @return EVENT_PROG_KEEP when no program is set.
+ */
+enum event_prog_verdict event_prog_run(const struct event_prog *prog, const struct scc_seccomp_data *data, const uint64_t *ret, u32 *weight);
+
+/**
+ * @brief Verify and install a program, replacing the current one.
+ *
+ * @param text The program as printed by `bpf_asm` or `tcpdump -ddd`: the number of
+ *             instructions, then "code jt jf k" for each one, all separated by commas.
+ *             An empty text removes the program.
+ *
+ * @return 0 on success, -EINVAL if the program is rejected, negative errno otherwise.
+ */
+int event_prog_load(const char *text);
+
+#endif // __SCC_EVENT_PROG_H__
@@ -0,0 +1,23 @@
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/ktime.h>
+
+#include "event_logger.h"
+#include "event_record.h"
+#include "event_schema.h"
+
+void event_to_schema(const struct event *event, struct event_schema *schema)
+{
+    if (unlikely(!event || !schema))
+        return;
+
+    schema->uid = event->uid;
+    schema->pid = event->pid;
+    schema->ppid = event->ppid;
+    schema->tid = event->tgid;
+    schema->timestamp = ktime_to_ns(event->tstamp);
+
+    schema->syscall_nr = event->info.data.nr;
+    memcpy(schema->syscall_args, event->info.data.args, sizeof(schema->syscall_args));
+    schema->syscall_ret = event->ret;
+}
@@ -0,0 +1,14 @@
+#ifndef __SCC_EVENT_RECORD_H__
+#define __SCC_EVENT_RECORD_H__
+
+struct event;
+struct event_schema;
+
+/**
+ * @brief Convert a cached event to the schema user space reads.
+ *
+ * A pure copy, the identity of the task was snapshotted at entry.
+ */
+void event_to_schema(const struct event *event, struct event_schema *schema);
+
+#endif // __SCC_EVENT_RECORD_H__
@@ -0,0 +1,422 @@
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/slab.h>
+#include <linux/percpu.h>
+#include <linux/preempt.h>
+#include <linux/atomic.h>
+#include <linux/compiler.h>
+#include <linux/version.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
+#include <linux/sched.h>
+#include <linux/sched/rt.h>
+#include <linux/sched/clock.h>
+#include <linux/timekeeping.h>
+
+#include "event_ring.h"
+#include "event_stats.h"
+
+static_assert((EVENT_RING_SLOTS & (EVENT_RING_SLOTS - 1)) == 0,
+              "EVENT_RING_SLOTS must be a power of 2.");
+static_assert(sizeof(struct event_record) == 128,
+              "The size of struct event_record must be 128 bytes.");
+static_assert(sizeof(struct event_strings) == 512,
+              "The size of struct event_strings must be 512 bytes.");
+
+#define EVENT_RING_MASK (EVENT_RING_SLOTS - 1)
+
+static inline int event_ring_pop(struct event_rings *rings, int cpu, struct event_record *records, struct event_strings *strings, int capacity);
+static inline void event_ring_discard(struct event_rings *rings, int cpu);
+static inline bool event_rings_ready(struct event_rings *rings);
+static inline void wait_for_room(struct event_rings *rings);
+static inline void put_lost_record(struct event_record *slot, int cpu, uint64_t seq, uint64_t lost);
+static inline void drop_oldest(struct event_rings *rings, int cpu, uint64_t tail);
+static inline void publish_ring(struct event_rings *rings, int cpu);
+static inline uint64_t repair_tail(struct event_ring_tail *tail, uint64_t seen, uint64_t head);
+static inline void arm_flush_timer(struct event_rings *rings);
+static void flush_timer_fn(struct timer_list *timer);
+
+struct event_rings *event_rings_create(void)
+{
+    struct event_rings *rings = kzalloc(sizeof(struct event_rings), GFP_KERNEL);
+    if (!rings)
+        return NULL;
+
+    init_waitqueue_head(&rings->waitqueue);
+    rings->wakeup_watermark = 1;
+    timer_setup(&rings->flush_timer, flush_timer_fn, 0);
+
+    rings->ctrl_size = PAGE_ALIGN(sizeof(struct event_ring_area) + nr_cpu_ids * sizeof(struct event_ring_ctrl));
+    rings->area = vmalloc_user(rings->ctrl_size);
+    // pages of their own, the only ones user space may write
+    rings->tails_size = PAGE_ALIGN(nr_cpu_ids * sizeof(struct event_ring_tail));
+    rings->tails = vmalloc_user(rings->tails_size);
+    // the strings of every ring follow the records of every ring, in the same mapping
+    rings->records = vmalloc_user(nr_cpu_ids * (EVENT_RING_SIZE + EVENT_STRINGS_RING_SIZE));
+    rings->state = kzalloc(array_size(nr_cpu_ids, sizeof(struct event_ring_state)), GFP_KERNEL);
+    if (!rings->area || !rings->tails || !rings->records || !rings->state)
+    {
+        printk(KERN_ERR "Failed to allocate the event rings\n");
+        event_rings_destroy(rings);
+        return NULL;
+    }
+    rings->strings = (struct event_strings *)(rings->records + nr_cpu_ids * EVENT_RING_SLOTS);
+
+    rings->area->header = (struct event_ring_header){
+        .version = EVENT_RING_VERSION,
+        .nr_cpus = nr_cpu_ids,
+        .nr_slots = EVENT_RING_SLOTS,
+        .record_size = sizeof(struct event_record),
+        .ctrl_size = rings->ctrl_size,
+        .ring_size = EVENT_RING_SIZE,
+        .strings_offset = rings->ctrl_size + rings->tails_size + nr_cpu_ids * EVENT_RING_SIZE,
+        .strings_size = sizeof(struct event_strings),
+        .tails_offset = rings->ctrl_size,
+        .records_offset = rings->ctrl_size + rings->tails_size,
+    };
+    return rings;
+}
+
+void event_rings_destroy(struct event_rings *rings)
+{
+    if (!rings)
+        return;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 2, 0)
+    timer_delete_sync(&rings->flush_timer);
+#else
+    del_timer_sync(&rings->flush_timer);
+#endif
+    kfree(rings->state);
+    vfree(rings->records);
+    vfree(rings->tails);
+    vfree(rings->area);
+    kfree(rings);
+}
+
+void event_rings_push(struct event_rings *rings, const struct event_record *record, const struct event_strings *strings)
+{
+    const enum event_overflow overflow = READ_ONCE(rings->overflow);
+    if (overflow == EVENT_OVERFLOW_BLOCK)
+        wait_for_room(rings);
+
+    preempt_disable();
+    const int cpu = smp_processor_id();
+    struct event_ring_state *state = rings->state + cpu;
+    struct event_ring_tail *ring_tail = rings->tails + cpu;
+    const size_t first = cpu * EVENT_RING_SLOTS;
+    const uint64_t start = state->head;
+    uint64_t head = start;
+    uint64_t tail = repair_tail(ring_tail, smp_load_acquire(&ring_tail->tail), head);
+    // seq counts the dropped events too, the gaps tell the reader how many it missed
+    const uint64_t seq = state->seq;
+    WRITE_ONCE(state->seq, seq + 1);
+
+    if (head - tail >= EVENT_RING_SLOTS)
+    {
+        if (overflow != EVENT_OVERFLOW_DROP_OLDEST)
+        {
+            WRITE_ONCE(state->lost, state->lost + 1);
+            event_stats_inc(EVENT_STAT_RING_DROPPED);
+            publish_ring(rings, cpu);
+            goto out;
+        }
+        drop_oldest(rings, cpu, tail);
+        tail = head - EVENT_RING_SLOTS + 1;
+    }
+
+    // report the losses ahead of the record, once there is room for both
+    uint64_t lost = min_t(uint64_t, state->lost - state->reported, U32_MAX);
+    if (unlikely(lost) && head - tail + 2 > EVENT_RING_SLOTS && overflow == EVENT_OVERFLOW_DROP_OLDEST)
+    {
+        // a saturated ring never has that room, the report takes the place of one more old record
+        tail = repair_tail(ring_tail, smp_load_acquire(&ring_tail->tail), head);
+        if (head - tail + 2 > EVENT_RING_SLOTS)
+        {
+            drop_oldest(rings, cpu, tail);
+            tail = head - EVENT_RING_SLOTS + 2;
+        }
+        lost = min_t(uint64_t, state->lost - state->reported, U32_MAX);
+    }
+    if (unlikely(lost) && head - tail + 2 <= EVENT_RING_SLOTS)
+    {
+        put_lost_record(rings->records + first + (head & EVENT_RING_MASK), cpu, seq, lost);
+        WRITE_ONCE(state->reported, state->reported + lost);
+        ++head;
+    }
+
+    const size_t slot = first + (head & EVENT_RING_MASK);
+    memcpy(rings->records + slot, record, sizeof(struct event_record));
+    rings->records[slot].cpu = cpu;
+    rings->records[slot].seq = seq;
+    if (strings && record->nr_strings)
+        memcpy(rings->strings + slot, strings, sizeof(struct event_strings));
+    smp_store_release(&state->head, head + 1);
+    // before any wakeup, a woken up consumer looks at the published head
+    publish_ring(rings, cpu);
+
+    // only the records crossing the watermark wake the reader, or the first ones once it timed out
+    const uint64_t queued = head + 1 - tail;
+    const uint64_t watermark = READ_ONCE(rings->wakeup_watermark);
+    if (unlikely((start - tail < watermark && queued >= watermark) || (start == tail && READ_ONCE(rings->flush_due))))
+    {
+        if (wq_has_sleeper(&rings->waitqueue))
+            wake_up_interruptible(&rings->waitqueue);
+    }
+out:
+    preempt_enable();
+}
+
+int event_rings_pop(struct event_rings *rings, struct event_record *records, struct event_strings *strings, int capacity)
+{
+    int size = 0, cpu;
+    for_each_possible_cpu(cpu)
+    {
+        if (size >= capacity)
+            break;
+        size += event_ring_pop(rings, cpu, records + size, strings ? strings + size : NULL, capacity - size);
+    }
+
+    // drained everything, the next wait gets a full timeout again
+    if (size < capacity)
+        WRITE_ONCE(rings->flush_due, false);
+    return size;
+}
+
+void event_rings_clear(struct event_rings *rings)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+        event_ring_discard(rings, cpu);
+}
+
+void event_rings_set_wakeup(struct event_rings *rings, unsigned int watermark, unsigned int timeout_ms)
+{
+    WRITE_ONCE(rings->wakeup_watermark, clamp_t(unsigned int, watermark, 1, EVENT_RING_SLOTS));
+    WRITE_ONCE(rings->wakeup_timeout, msecs_to_jiffies(timeout_ms));
+    wake_up_interruptible(&rings->waitqueue);
+}
+
+void event_rings_set_overflow(struct event_rings *rings, enum event_overflow overflow, unsigned int block_us)
+{
+    WRITE_ONCE(rings->block_ns, (u64)min_t(unsigned int, block_us, EVENT_OVERFLOW_BLOCK_MAX_US) * NSEC_PER_USEC);
+    WRITE_ONCE(rings->overflow, overflow);
+}
+
+void event_rings_get_wakeup(struct event_rings *rings, unsigned int *watermark, unsigned int *timeout_ms)
+{
+    *watermark = READ_ONCE(rings->wakeup_watermark);
+    *timeout_ms = jiffies_to_msecs(READ_ONCE(rings->wakeup_timeout));
+}
+
+int event_rings_wait(struct event_rings *rings)
+{
+    if (event_rings_ready(rings))
+        return 0;
+
+    arm_flush_timer(rings);
+    return wait_event_interruptible(rings->waitqueue, event_rings_ready(rings));
+}
+
+__poll_t event_rings_poll(struct event_rings *rings, struct file *filp, struct poll_table_struct *wait)
+{
+    poll_wait(filp, &rings->waitqueue, wait);
+    if (event_rings_ready(rings))
+        return EPOLLIN | EPOLLRDNORM;
+
+    arm_flush_timer(rings);
+    return 0;
+}
+
+// the kernel writes it alone, user space may only read it
+static inline int deny_write(struct vm_area_struct *vma)
+{
+    if (vma->vm_flags & VM_WRITE)
+        return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+    vm_flags_clear(vma, VM_MAYWRITE);
+#else
+    vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+    return 0;
+}
+
+int event_rings_mmap(struct event_rings *rings, struct vm_area_struct *vma)
+{
+    const unsigned long ctrl_pages = rings->ctrl_size >> PAGE_SHIFT;
+    const unsigned long tails_pages = rings->tails_size >> PAGE_SHIFT;
+    // consumers only hand back the tail index
+    if (vma->vm_pgoff >= ctrl_pages && vma->vm_pgoff < ctrl_pages + tails_pages)
+        return remap_vmalloc_range(vma, rings->tails, vma->vm_pgoff - ctrl_pages);
+
+    int rc = deny_write(vma);
+    if (rc < 0)
+        return rc;
+    if (vma->vm_pgoff < ctrl_pages)
+        return remap_vmalloc_range(vma, rings->area, vma->vm_pgoff);
+    return remap_vmalloc_range(vma, rings->records, vma->vm_pgoff - ctrl_pages - tails_pages);
+}
+
+static inline int event_ring_pop(struct event_rings *rings, int cpu, struct event_record *records, struct event_strings *strings, int capacity)
+{
+    struct event_ring_tail *ring_tail = rings->tails + cpu;
+    const size_t first = cpu * EVENT_RING_SLOTS;
+    uint64_t tail = READ_ONCE(ring_tail->tail);
+    while (1)
+    {
+        // loaded after the tail, so that the tail can never be ahead of it
+        const uint64_t head = smp_load_acquire(&rings->state[cpu].head);
+        tail = repair_tail(ring_tail, tail, head);
+        const uint64_t n = min_t(uint64_t, head - tail, capacity);
+        if (n == 0)
+            return 0;
+
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            const size_t slot = first + ((tail + i) & EVENT_RING_MASK);
+            // drop-oldest may overwrite the slot meanwhile, the cmpxchg on tail tells
+            data_race(memcpy(records + i, rings->records + slot, sizeof(struct event_record)));
+            if (strings && records[i].nr_strings)
+                data_race(memcpy(strings + i, rings->strings + slot, sizeof(struct event_strings)));
+        }
+
+        // the producer may have dropped what we just copied, retry from its tail if so
+        const uint64_t seen = cmpxchg(&ring_tail->tail, tail, tail + n);
+        if (likely(seen == tail))
+            return n;
+        event_stats_inc(EVENT_STAT_RING_RETRIES);
+        tail = seen;
+    }
+}
+
+static inline void event_ring_discard(struct event_rings *rings, int cpu)
+{
+    struct event_ring_tail *ring_tail = rings->tails + cpu;
+    uint64_t tail = READ_ONCE(ring_tail->tail);
+    while (1)
+    {
+        const uint64_t head = smp_load_acquire(&rings->state[cpu].head);
+        const uint64_t seen = cmpxchg(&ring_tail->tail, tail, head);
+        if (seen == tail)
+            return;
+        tail = seen;
+    }
+}
+
+static inline bool event_rings_ready(struct event_rings *rings)
+{
+    const unsigned int watermark = READ_ONCE(rings->wakeup_watermark);
+    const bool due = READ_ONCE(rings->flush_due);
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        const uint64_t tail = READ_ONCE(rings->tails[cpu].tail);
+        const uint64_t queued = smp_load_acquire(&rings->state[cpu].head) - tail;
+        if (queued >= watermark || (queued && due))
+            return true;
+    }
+    return false;
+}
+
+static inline bool event_ring_full(struct event_rings *rings, int cpu)
+{
+    const uint64_t tail = READ_ONCE(rings->tails[cpu].tail);
+    return READ_ONCE(rings->state[cpu].head) - tail >= EVENT_RING_SLOTS;
+}
+
+// spin rather than sleep, the syscall path holds rcu_read_lock()
+static inline void wait_for_room(struct event_rings *rings)
+{
+    // never hold back the tasks that cannot afford it
+    if (rt_task(current) || (current->flags & PF_KTHREAD))
+        return;
+    if (likely(!event_ring_full(rings, raw_smp_processor_id())))
+        return;
+
+    if (wq_has_sleeper(&rings->waitqueue))
+        wake_up_interruptible(&rings->waitqueue);
+    const u64 deadline = local_clock() + READ_ONCE(rings->block_ns);
+    while (event_ring_full(rings, raw_smp_processor_id()) && local_clock() < deadline)
+        cpu_relax();
+}
+
+// drop the record at @tail. A failed cmpxchg means the reader has just freed a slot for us.
+static inline void drop_oldest(struct event_rings *rings, int cpu, uint64_t tail)
+{
+    struct event_ring_state *state = rings->state + cpu;
+    if (cmpxchg(&rings->tails[cpu].tail, tail, tail + 1) != tail)
+    {
+        event_stats_inc(EVENT_STAT_RING_RETRIES);
+        return;
+    }
+
+    const struct event_record *oldest = rings->records + cpu * EVENT_RING_SLOTS + (tail & EVENT_RING_MASK);
+    // not an event, what it reported is reported again by the next one
+    if (unlikely(oldest->flags & EVENT_RECORD_LOST))
+    {
+        // a tail moved by user space may land on a loss record already given back
+        WRITE_ONCE(state->reported, state->reported - min_t(uint64_t, oldest->weight, state->reported));
+    }
+    else
+    {
+        WRITE_ONCE(state->lost, state->lost + 1);
+        event_stats_inc(EVENT_STAT_RING_DROPPED);
+    }
+}
+
+// copy the indexes of the ring of @cpu to the control area, head last
+static inline void publish_ring(struct event_rings *rings, int cpu)
+{
+    const struct event_ring_state *state = rings->state + cpu;
+    struct event_ring_ctrl *ctrl = rings->area->rings + cpu;
+    WRITE_ONCE(ctrl->seq, state->seq);
+    WRITE_ONCE(ctrl->lost, state->lost);
+    WRITE_ONCE(ctrl->reported, state->reported);
+    smp_store_release(&ctrl->head, state->head);
+}
+
+/* User space may write anything to a tail. A producer never lets its ring hold more than
+ * EVENT_RING_SLOTS records, so a tail further than that behind @head, or ahead of it, can
+ * only come from there: move it back to @head, as if the consumer had read everything.
+ * @seen must be loaded before @head.
+ */
+static inline uint64_t repair_tail(struct event_ring_tail *ring_tail, uint64_t seen, uint64_t head)
+{
+    if (likely(head - seen <= EVENT_RING_SLOTS))
+        return seen;
+    const uint64_t tail = cmpxchg(&ring_tail->tail, seen, head);
+    return tail == seen ? head : tail;
+}
+
+static inline void put_lost_record(struct event_record *slot, int cpu, uint64_t seq, uint64_t lost)
+{
+    *slot = (struct event_record){
+        .schema = {
+            .timestamp = ktime_get_ns(),
+            .syscall_nr = EVENT_LOST_NR,
+            .syscall_args = {cpu},
+            .syscall_ret = lost,
+        },
+        .weight = lost,
+        .cpu = cpu,
+        .flags = EVENT_RECORD_LOST,
+        .seq = seq,
+    };
+}
+
+static inline void arm_flush_timer(struct event_rings *rings)
+{
+    const unsigned long timeout = READ_ONCE(rings->wakeup_timeout);
+    if (timeout == 0 || READ_ONCE(rings->flush_due) || timer_pending(&rings->flush_timer))
+        return;
+    mod_timer(&rings->flush_timer, jiffies + timeout);
+}
+
+static void flush_timer_fn(struct timer_list *timer)
+{
+    struct event_rings *rings = container_of(timer, struct event_rings, flush_timer);
+    WRITE_ONCE(rings->flush_due, true);
+    wake_up_interruptible(&rings->waitqueue);
+}
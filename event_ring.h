@@ -0,0 +1,153 @@
+#ifndef __SCC_EVENT_RING_H__
+#define __SCC_EVENT_RING_H__
+#include <linux/types.h>
+#include <linux/wait.h>
+#include <linux/timer.h>
+
+#include "event_schema.h"
+
+struct vm_area_struct;
+struct file;
+struct poll_table_struct;
+
+// 16 KiB per CPU, must be a power of 2
+#define EVENT_RING_SIZE (PAGE_SIZE << 2)
+#define EVENT_RING_SLOTS (EVENT_RING_SIZE / sizeof(struct event_record))
+// the strings of the records, one struct event_strings per slot
+#define EVENT_STRINGS_RING_SIZE (EVENT_RING_SLOTS * sizeof(struct event_strings))
+
+// the indexes of a ring only its producer writes, a cache line each
+struct event_ring_state
+{
+    uint64_t head;
+    uint64_t seq;
+    uint64_t lost;
+    uint64_t reported;
+    uint64_t reserved[4];
+};
+
+// what a producer does when the ring of its CPU is full
+enum event_overflow
+{
+    // overwrite the oldest record, the default
+    EVENT_OVERFLOW_DROP_OLDEST,
+    // keep the ring as is and drop the new record
+    EVENT_OVERFLOW_DROP_NEWEST,
+    // give the reader a little time to make room, then drop the new record
+    EVENT_OVERFLOW_BLOCK,
+};
+
+// the longest a producer may wait with EVENT_OVERFLOW_BLOCK
+#define EVENT_OVERFLOW_BLOCK_MAX_US 1000
+
+/**
+ * @brief Single-producer event rings of one consumer, one ring per CPU.
+ *
+ * Only the owning CPU writes the slots of its ring and advances its `head`, with preemption
+ * disabled. The reader advances `tail`. When a ring is full the producer drops the oldest
+ * record by pushing the tail forward with cmpxchg, so the reader has to confirm with
+ * cmpxchg that the records it copied were not dropped meanwhile. Every loss is counted and
+ * reported in-band by a loss record, see event_schema.h.
+ *
+ * The producer keeps its indexes in `state`, out of reach of user space, and publishes a
+ * copy of them to the read-only control area. Only the tails are shared read-write, see
+ * event_schema.h.
+ */
+struct event_rings
+{
+    // shared with user space through mmap()
+    struct event_ring_area *area;
+    struct event_ring_tail *tails;
+    struct event_record *records;
+    struct event_strings *strings;
+    size_t ctrl_size;
+    size_t tails_size;
+    // what the producer of each ring owns, never mapped
+    struct event_ring_state *state;
+
+    // wake the reader once a ring holds `wakeup_watermark` records, or after `wakeup_timeout` jiffies
+    wait_queue_head_t waitqueue;
+    unsigned int wakeup_watermark;
+    unsigned long wakeup_timeout;
+    struct timer_list flush_timer;
+    bool flush_due;
+
+    enum event_overflow overflow;
+    u64 block_ns;
+};
+
+/**
+ * @brief Allocate a ring for every possible CPU.
+ *
+ * @return The rings, NULL without memory.
+ */
+struct event_rings *event_rings_create(void);
+
+void event_rings_destroy(struct event_rings *rings);
+
+/**
+ * @brief Append a record to the ring of the current CPU.
+ *
+ * Never sleeps and never takes a lock, a full ring drops a record according to its overflow policy.
+ *
+ * @param strings The strings of the record when `record->nr_strings` is set, NULL otherwise.
+ */
+void event_rings_push(struct event_rings *rings, const struct event_record *record, const struct event_strings *strings);
+
+/**
+ * @brief Move up to `capacity` records out of the rings of all CPUs.
+ *
+ * @param strings Receives the strings of records[i] in strings[i], may be NULL.
+ *
+ * @return The number of records copied to @records.
+ *
+ * ! Only one reader may drain the rings at a time.
+ */
+int event_rings_pop(struct event_rings *rings, struct event_record *records, struct event_strings *strings, int capacity);
+
+/**
+ * @brief Drop everything currently queued on all CPUs.
+ */
+void event_rings_clear(struct event_rings *rings);
+
+/**
+ * @brief Configure when a sleeping reader gets woken up.
+ *
+ * @param watermark Wake the reader once any CPU has queued this many records, clamped to the ring size.
+ * @param timeout_ms Also wake it once this much time passed with records queued, 0 to disable.
+ */
+void event_rings_set_wakeup(struct event_rings *rings, unsigned int watermark, unsigned int timeout_ms);
+
+void event_rings_get_wakeup(struct event_rings *rings, unsigned int *watermark, unsigned int *timeout_ms);
+
+/**
+ * @brief Choose what happens to the records pushed to a full ring.
+ *
+ * @param block_us How long a producer waits for room with EVENT_OVERFLOW_BLOCK, clamped to
+ * EVENT_OVERFLOW_BLOCK_MAX_US. Real-time tasks and kernel threads never wait.
+ */
+void event_rings_set_overflow(struct event_rings *rings, enum event_overflow overflow, unsigned int block_us);
+
+/**
+ * @brief Block the current thread until the rings are ready to be read.
+ *
+ * @return 0 when ready, -ERESTARTSYS if interrupted by a signal.
+ */
+int event_rings_wait(struct event_rings *rings);
+
+/**
+ * @brief The .poll file operation of the rings.
+ */
+__poll_t event_rings_poll(struct event_rings *rings, struct file *filp, struct poll_table_struct *wait);
+
+/**
+ * @brief Map the control area, the tails or the records into user space.
+ *
+ * The control area is mapped at offset 0 and the records and their strings after the tails,
+ * read-only. Only the tails can be mapped writable.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int event_rings_mmap(struct event_rings *rings, struct vm_area_struct *vma);
+
+#endif // __SCC_EVENT_RING_H__
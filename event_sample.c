@@ -0,0 +1,201 @@
+#include <linux/percpu.h>
+#include <linux/hash.h>
+#include <linux/bitmap.h>
+#include <linux/timekeeping.h>
+#include <linux/math64.h>
+#include <linux/minmax.h>
+
+#include "event_sample.h"
+#include "syscall_hook.h"
+#include "event_config.h"
+#include "event_stats.h"
+
+// 4-way set associative, a process only takes the slot of the least recently seen one of its set
+#define SAMPLE_SET_BITS 4
+#define SAMPLE_WAYS 4
+#define SAMPLE_BUCKETS (SAMPLE_WAYS << SAMPLE_SET_BITS)
+// the syscalls of a process whose dropped weight is carried at once, a busy process only makes a few
+#define SAMPLE_SUPPRESSED 4
+
+// the weight of the events of @nr dropped since the last emitted one, free while 0
+struct sample_suppressed
+{
+    long nr;
+    u32 weight;
+};
+
+struct sample_bucket
+{
+    pid_t tgid;
+    u32 tokens;
+    u64 last_refill;
+    u64 last_seen;
+    struct sample_suppressed suppressed[SAMPLE_SUPPRESSED];
+};
+
+struct sample_state
+{
+    u32 counts[HOOK_NR_SYSCALLS];
+    struct sample_bucket buckets[SAMPLE_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct sample_state, sample_states);
+
+static inline bool bucket_take(struct sample_bucket *bucket, u64 now, u32 rate, u32 burst)
+{
+    if (bucket->tokens == 0)
+    {
+        const u64 elapsed = now - bucket->last_refill;
+        if (elapsed >= NSEC_PER_SEC)
+        {
+            bucket->tokens = burst;
+            bucket->last_refill = now;
+        }
+        else
+        {
+            const u64 refill = div_u64(elapsed * rate, NSEC_PER_SEC);
+            if (refill == 0)
+                return false;
+            bucket->tokens = min_t(u64, refill, burst);
+            // only account the time the tokens stand for, the rest goes to the next refill
+            bucket->last_refill += div_u64(refill * NSEC_PER_SEC, rate);
+        }
+    }
+
+    bucket->tokens--;
+    return true;
+}
+
+// the weight only goes to the next emitted event of the same syscall, the counts per syscall stay exact
+static void suppress(struct sample_bucket *bucket, long nr, u32 weight)
+{
+    struct sample_suppressed *slot = NULL;
+    for (int i = 0; i < SAMPLE_SUPPRESSED; ++i)
+    {
+        struct sample_suppressed *s = bucket->suppressed + i;
+        if (s->weight && s->nr == nr)
+        {
+            slot = s;
+            break;
+        }
+        if (!slot || s->weight < slot->weight)
+            slot = s;
+    }
+
+    if (slot->nr != nr)
+    {
+        // the lightest syscall makes room, no event is left to carry its weight
+        event_stats_add(EVENT_STAT_SAMPLE_ORPHANED, slot->weight);
+        *slot = (struct sample_suppressed){.nr = nr, .weight = 0};
+    }
+    slot->weight = min_t(u64, (u64)slot->weight + weight, U32_MAX);
+}
+
+static u32 unsuppress(struct sample_bucket *bucket, long nr)
+{
+    for (int i = 0; i < SAMPLE_SUPPRESSED; ++i)
+    {
+        struct sample_suppressed *s = bucket->suppressed + i;
+        if (s->weight && s->nr == nr)
+        {
+            const u32 weight = s->weight;
+            s->weight = 0;
+            return weight;
+        }
+    }
+    return 0;
+}
+
+static struct sample_bucket *bucket_get(struct sample_state *state, pid_t tgid, u64 now, u32 burst)
+{
+    struct sample_bucket *set = state->buckets + hash_32(tgid, SAMPLE_SET_BITS) * SAMPLE_WAYS;
+    struct sample_bucket *victim = set;
+    for (int i = 0; i < SAMPLE_WAYS; ++i)
+    {
+        if (set[i].tgid == tgid)
+        {
+            set[i].last_seen = now;
+            return set + i;
+        }
+        if (set[i].last_seen < victim->last_seen)
+            victim = set + i;
+    }
+
+    // no event of that process is left to carry it, any other event would be miscounted
+    for (int i = 0; i < SAMPLE_SUPPRESSED; ++i)
+        event_stats_add(EVENT_STAT_SAMPLE_ORPHANED, victim->suppressed[i].weight);
+    *victim = (struct sample_bucket){
+        .tgid = tgid,
+        .tokens = burst,
+        .last_refill = now,
+        .last_seen = now,
+    };
+    return victim;
+}
+
+u32 event_sample(const struct scc_config *config, long nr, pid_t tgid)
+{
+    u32 weight = 1;
+    struct sample_state *state = get_cpu_ptr(&sample_states);
+
+    if (nr >= 0 && nr < HOOK_NR_SYSCALLS)
+    {
+        const u32 every = config->sample_every[nr];
+        if (every > 1)
+        {
+            if (++state->counts[nr] < every)
+            {
+                weight = 0;
+                goto out;
+            }
+            state->counts[nr] = 0;
+            weight = every;
+        }
+    }
+
+    const u32 rate = config->limit_rate;
+    if (rate)
+    {
+        const u64 now = ktime_get_ns();
+        struct sample_bucket *bucket = bucket_get(state, tgid, now, config->limit_burst);
+
+        if (!bucket_take(bucket, now, rate, config->limit_burst))
+        {
+            suppress(bucket, nr, weight);
+            weight = 0;
+            goto out;
+        }
+        weight = min_t(u64, (u64)weight + unsuppress(bucket, nr), U32_MAX);
+    }
+
+out:
+    put_cpu_ptr(&sample_states);
+    return weight;
+}
+
+int event_sample_set_rate(const unsigned long *syscalls, unsigned int every)
+{
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+
+    for (int i = 0; i < HOOK_NR_SYSCALLS; ++i)
+    {
+        if (!syscalls || test_bit(i, syscalls))
+            config->sample_every[i] = every;
+    }
+    event_config_publish(config);
+    return 0;
+}
+
+int event_sample_set_limit(unsigned int rate, unsigned int burst)
+{
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+
+    config->limit_rate = rate;
+    config->limit_burst = burst ? burst : rate;
+    event_config_publish(config);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#ifndef __SCC_EVENT_SAMPLE_H__
+#define __SCC_EVENT_SAMPLE_H__
+#include <linux/types.h>
+
+struct scc_config;
+
+/**
+ * @brief Decide whether to capture the syscall @nr of the process @tgid, and its weight.
+ *
+ * Applies the 1-in-N sampling of @nr first, then the token bucket of @tgid, with the rates
+ * of @config. Both keep their state per CPU, so the sampling is 1-in-N on each CPU and the
+ * rate limit is per process on each CPU.
+ *
+ * @return The number of syscalls the captured event stands for, 0 to drop it.
+ */
+u32 event_sample(const struct scc_config *config, long nr, pid_t tgid);
+
+/**
+ * @brief Capture one in @every syscalls of @syscalls.
+ *
+ * @param syscalls Bitmap of HOOK_NR_SYSCALLS bits, NULL for all syscalls.
+ * @param every 0 or 1 to capture all of them.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int event_sample_set_rate(const unsigned long *syscalls, unsigned int every);
+
+/**
+ * @brief Limit how many events each process may emit.
+ *
+ * @param rate Events per second, 0 to disable the limit.
+ * @param burst Events a process may emit at once, 0 for @rate.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int event_sample_set_limit(unsigned int rate, unsigned int burst);
+
+#endif // __SCC_EVENT_SAMPLE_H__
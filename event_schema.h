@@ -20,4 +20,159 @@ struct event_schema
     uint64_t syscall_ret;
 };
 
+/**
+ * The per-CPU event rings can be consumed in place by mmap(2) on /dev/scc.
+ *
+ * - Offset 0 maps the control area (read-only): a `struct event_ring_area`
+ *   holding the layout header and what the kernel publishes of every ring,
+ *   its `head` among others.
+ * - Offset `header.tails_offset` maps the tails (read-write): a `struct
+ *   event_ring_tail` per ring, the only thing a consumer writes.
+ * - Offset `header.records_offset` maps the records (read-only): `header.nr_cpus`
+ *   rings of `header.ring_size` bytes each, ring N belongs to CPU N.
+ *
+ * A consumer loads `head` with acquire semantics, reads the records in
+ * [tail, head), then publishes the new tail with compare-and-swap. When the
+ * ring is full and the open file drops the oldest records (the default
+ * `overflow` policy), the kernel advances `tail` itself, so a failed
+ * compare-and-swap means some of the records just read were overwritten;
+ * restart from the new tail. The kernel keeps the indexes it owns to itself,
+ * a tail more than a ring away from `head` is moved back to `head`.
+ *
+ * Every event offered to a ring gets the next `seq` of that ring, whether it
+ * is kept or dropped, so a gap in `seq` is exactly the number of events lost
+ * in between. `lost` counts them all. The kernel also queues a loss record,
+ * `syscall_nr` EVENT_LOST_NR with EVENT_RECORD_LOST in `flags`, ahead of the
+ * next event: right away when dropping the oldest records, where it overwrites
+ * one more of them, otherwise once the ring has room for both. Its `weight` is
+ * the number of events lost since the previous one and its `seq` is the one of
+ * the next event. In the legacy read() format a
+ * loss record has the count in `syscall_ret` and the CPU in `syscall_args[0]`.
+ *
+ * Indexes are free running, the slot of index i is `i & (header.nr_slots - 1)`.
+ *
+ * A record with `nr_strings` set has the strings read from its arguments in a
+ * `struct event_strings` of the same slot, found at `header.strings_offset +
+ * (N * header.nr_slots + slot) * header.strings_size` in the mapping for ring N.
+ * It is part of the record, read it before publishing the new tail.
+ */
+#define EVENT_RING_VERSION 4
+
+// the syscall_nr of a loss record
+#define EVENT_LOST_NR -1
+// struct event_record flags
+#define EVENT_RECORD_LOST 0x1
+
+// at most 2 strings per syscall, e.g. both paths of rename
+#define EVENT_STRINGS_MAX 2
+// a string of EVENT_STRING_SIZE - 1 bytes was probably cut
+#define EVENT_STRING_SIZE 252
+
+struct event_strings
+{
+    uint8_t nr;
+    // the argument each string was read from
+    uint8_t arg[EVENT_STRINGS_MAX];
+    uint8_t reserved;
+    // the length of each string without its NUL, 0 if it could not be read
+    uint16_t len[EVENT_STRINGS_MAX];
+    // NUL terminated, execve's argv is captured with its strings joined by spaces
+    char str[EVENT_STRINGS_MAX][EVENT_STRING_SIZE];
+};
+
+struct event_record
+{
+    struct event_schema schema;
+    // the number of syscalls this record stands for, more than 1 when sampled or rate limited
+    uint32_t weight;
+    // the CPU whose ring the record went through
+    uint32_t cpu;
+    // the time the syscall took in ns, 0 unless latency is measured
+    uint64_t duration;
+    // the strings captured from the arguments, see struct event_strings
+    uint32_t nr_strings;
+    // EVENT_RECORD_*
+    uint32_t flags;
+    // the events offered to this ring before this one, per open file. A loss record takes no
+    // seq of its own, it has the one of the event queued right after it.
+    uint64_t seq;
+    // reserved for future use, and align to 128 bytes
+    uint64_t reserved[1];
+};
+
+struct event_ring_header
+{
+    uint32_t version;
+    uint32_t nr_cpus;
+    uint32_t nr_slots;
+    uint32_t record_size;
+    uint64_t ctrl_size;
+    uint64_t ring_size;
+    uint64_t strings_offset;
+    uint32_t strings_size;
+    uint32_t reserved;
+    uint64_t tails_offset;
+    uint64_t records_offset;
+};
+
+// a copy of what the kernel keeps of a ring, published along with head
+struct event_ring_ctrl
+{
+    uint64_t head;
+    uint64_t seq;
+    uint64_t lost;
+    uint64_t reported;
+    uint64_t reserved[4];
+};
+
+// on a cache line of its own, written by the consumer and by the kernel dropping the oldest records
+struct event_ring_tail
+{
+    uint64_t tail;
+    uint64_t reserved[7];
+};
+
+struct event_ring_area
+{
+    union
+    {
+        struct event_ring_header header;
+        uint64_t header_reserved[16];
+    };
+    struct event_ring_ctrl rings[];
+};
+
+/**
+ * The compact stream format, selected per open with the `format compact` command.
+ *
+ * A read() returns whole blocks. Each block is a `struct event_compact_header`
+ * followed by `size` bytes holding `nr_records` records of the same CPU. A
+ * record is a sequence of varints (LEB128, signed ones zigzag encoded):
+ *
+ *   timestamp delta (signed, from the previous record, the first one from
+ *   `base_timestamp`), seq delta (from the previous record, the first one
+ *   from 0), flags, syscall_nr, pid, tid, ppid, uid, syscall_ret (signed),
+ *   weight, duration, nargs, then nargs syscall_args.
+ *
+ * A loss record has EVENT_RECORD_LOST in its flags and no arguments, see the
+ * mmap layout above.
+ *
+ * nargs is the real argument count of the syscall, so no table is needed to
+ * decode a record. Then comes a byte with the number of strings captured, and
+ * for each of them a byte with its argument, its length (varint) and its bytes without
+ * the NUL.
+ */
+#define EVENT_COMPACT_VERSION 3
+
+struct event_compact_header
+{
+    uint8_t version;
+    uint8_t reserved0;
+    uint16_t cpu;
+    uint32_t nr_records;
+    uint32_t size;
+    uint32_t reserved1;
+    uint64_t base_timestamp;
+};
+
 #endif // __SCC_EVENT_SCHEMA_H__
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/jump_label.h>
+#include <linux/string.h>
+
+#include "event_stats.h"
+
+DEFINE_PER_CPU(struct event_stats, event_stats);
+DEFINE_STATIC_KEY_FALSE(event_stats_profiling);
+
+static const char *const stat_names[EVENT_STAT_NR] = {
+    [EVENT_STAT_CAPTURED] = "captured",
+    [EVENT_STAT_FILTERED] = "filtered",
+    [EVENT_STAT_SAMPLED] = "sampled",
+    [EVENT_STAT_SAMPLE_ORPHANED] = "sample_orphaned",
+    [EVENT_STAT_PROG_DROPPED] = "prog_dropped",
+    [EVENT_STAT_RING_DROPPED] = "ring_dropped",
+    [EVENT_STAT_EXIT_MISSED] = "exit_missed",
+    [EVENT_STAT_EXIT_STALE] = "exit_stale",
+    [EVENT_STAT_ALLOC_FAILED] = "alloc_failed",
+    [EVENT_STAT_STRINGS_FAILED] = "strings_failed",
+    [EVENT_STAT_CACHE_EVICTED] = "cache_evicted",
+    [EVENT_STAT_CACHE_FULL] = "cache_full",
+    [EVENT_STAT_CACHE_RETRIES] = "cache_retries",
+    [EVENT_STAT_RING_RETRIES] = "ring_retries",
+};
+
+static const char *const stage_names[EVENT_STAGE_NR] = {
+    [EVENT_STAGE_ENTRY] = "entry",
+    [EVENT_STAGE_CAPTURE] = "capture",
+    [EVENT_STAGE_CACHE_INSERT] = "cache_insert",
+    [EVENT_STAGE_CACHE_TAKE] = "cache_take",
+    [EVENT_STAGE_EXIT] = "exit",
+    [EVENT_STAGE_PUSH] = "push",
+    [EVENT_STAGE_READ] = "read",
+};
+
+static int event_stats_show(struct seq_file *m, void *v);
+DEFINE_SHOW_ATTRIBUTE(event_stats);
+static int event_cycles_show(struct seq_file *m, void *v);
+DEFINE_SHOW_ATTRIBUTE(event_cycles);
+
+void event_stats_init(struct dentry *dir)
+{
+    debugfs_create_file("self", 0444, dir, NULL, &event_stats_fops);
+    debugfs_create_file("cycles", 0444, dir, NULL, &event_cycles_fops);
+}
+
+void event_stats_set_profiling(bool enable)
+{
+    if (!enable)
+    {
+        static_branch_disable(&event_stats_profiling);
+        return;
+    }
+    if (static_branch_unlikely(&event_stats_profiling))
+        return;
+
+    // the CPUs do not count yet, nothing races with the reset
+    int cpu;
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(&event_stats, cpu)->cycles, 0, sizeof(event_stats.cycles));
+    static_branch_enable(&event_stats_profiling);
+}
+
+// one line per counter summed over all CPUs: "<name> <value>"
+static int event_stats_show(struct seq_file *m, void *v)
+{
+    for (int i = 0; i < EVENT_STAT_NR; ++i)
+    {
+        u64 sum = 0;
+        int cpu;
+        for_each_possible_cpu(cpu)
+            sum += READ_ONCE(per_cpu_ptr(&event_stats, cpu)->counters[i]);
+        seq_printf(m, "%s %llu\n", stat_names[i], sum);
+    }
+    return 0;
+}
+
+// one line per stage timed at least once: "<name> <cycle buckets...>"
+static int event_cycles_show(struct seq_file *m, void *v)
+{
+    seq_puts(m, "# stage cycles=0 cycles<2 cycles<4 ... cycles>=2^30\n");
+    for (int i = 0; i < EVENT_STAGE_NR; ++i)
+    {
+        u64 sum[EVENT_STATS_CYCLE_BUCKETS] = {0}, total = 0;
+        int cpu;
+        for_each_possible_cpu(cpu)
+        {
+            const struct event_stats *s = per_cpu_ptr(&event_stats, cpu);
+            for (int j = 0; j < EVENT_STATS_CYCLE_BUCKETS; ++j)
+                sum[j] += READ_ONCE(s->cycles[i][j]);
+        }
+        for (int j = 0; j < EVENT_STATS_CYCLE_BUCKETS; ++j)
+            total += sum[j];
+        if (total == 0)
+            continue;
+
+        seq_printf(m, "%s", stage_names[i]);
+        for (int j = 0; j < EVENT_STATS_CYCLE_BUCKETS; ++j)
+            seq_printf(m, " %llu", sum[j]);
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+#ifndef __SCC_EVENT_STATS_H__
+#define __SCC_EVENT_STATS_H__
+#include <linux/types.h>
+#include <linux/percpu.h>
+#include <linux/jump_label.h>
+#include <linux/bitops.h>
+#include <linux/minmax.h>
+#include <asm/timex.h>
+
+struct dentry;
+
+// what happened to the syscalls SCC saw, the cost of SCC itself
+enum event_stat
+{
+    // queued for the consumers
+    EVENT_STAT_CAPTURED,
+    // dropped by the filter tables
+    EVENT_STAT_FILTERED,
+    // dropped by the sampling or the rate limit
+    EVENT_STAT_SAMPLED,
+    // the weight a rate limited process had suppressed that no event of the same syscall is left to carry
+    EVENT_STAT_SAMPLE_ORPHANED,
+    // dropped by the filter program, at entry or exit
+    EVENT_STAT_PROG_DROPPED,
+    // lost on a full ring, once per consumer
+    EVENT_STAT_RING_DROPPED,
+    // the event cached at entry was gone at exit, evicted meanwhile. Only known with the table backend
+    EVENT_STAT_EXIT_MISSED,
+    // the event cached at exit belongs to another syscall
+    EVENT_STAT_EXIT_STALE,
+    // the event pool was exhausted
+    EVENT_STAT_ALLOC_FAILED,
+    // the strings pool was exhausted, the event went without its strings
+    EVENT_STAT_STRINGS_FAILED,
+    // an in-flight event evicted from a full cache window
+    EVENT_STAT_CACHE_EVICTED,
+    // an event dropped because every slot of its cache window was contended
+    EVENT_STAT_CACHE_FULL,
+    // failed cmpxchg on a cache slot
+    EVENT_STAT_CACHE_RETRIES,
+    // failed cmpxchg on the tail of a ring, by the producer or the reader
+    EVENT_STAT_RING_RETRIES,
+    EVENT_STAT_NR,
+};
+
+// the stages timed while profiling
+enum event_stage
+{
+    // the whole syscall entry, event_logger()
+    EVENT_STAGE_ENTRY,
+    // get_current_event()
+    EVENT_STAGE_CAPTURE,
+    EVENT_STAGE_CACHE_INSERT,
+    EVENT_STAGE_CACHE_TAKE,
+    // the whole syscall exit, post_event_logger()
+    EVENT_STAGE_EXIT,
+    // the copy to the rings of every consumer
+    EVENT_STAGE_PUSH,
+    // a get_events() call
+    EVENT_STAGE_READ,
+    EVENT_STAGE_NR,
+};
+
+// cycles[0] counts the durations of 0 cycles, cycles[i] those in [2^(i-1), 2^i), the last one the rest
+#define EVENT_STATS_CYCLE_BUCKETS 32
+
+struct event_stats
+{
+    u64 counters[EVENT_STAT_NR];
+    u64 cycles[EVENT_STAGE_NR][EVENT_STATS_CYCLE_BUCKETS];
+};
+
+DECLARE_PER_CPU(struct event_stats, event_stats);
+DECLARE_STATIC_KEY_FALSE(event_stats_profiling);
+
+/**
+ * @brief Expose the counters as `self` and the stage histograms as `cycles` under @dir.
+ */
+void event_stats_init(struct dentry *dir);
+
+/**
+ * @brief Start or stop timing the stages, starting clears the histograms.
+ *
+ * Patches the code, so it may sleep.
+ *
+ * ! Must be called under event_config_lock(), the check and the reset are not atomic.
+ */
+void event_stats_set_profiling(bool enable);
+
+/**
+ * @brief Count @n occurrences of @stat on the current CPU.
+ *
+ * Never sleeps and never takes a lock.
+ */
+static __always_inline void event_stats_add(enum event_stat stat, u64 n)
+{
+    this_cpu_add(event_stats.counters[stat], n);
+}
+
+static __always_inline void event_stats_inc(enum event_stat stat)
+{
+    this_cpu_inc(event_stats.counters[stat]);
+}
+
+/**
+ * @brief Start timing a stage.
+ *
+ * @return The current cycle count, 0 when not profiling. A jump patched out of the way otherwise.
+ */
+static __always_inline u64 event_stats_begin(void)
+{
+    if (static_branch_unlikely(&event_stats_profiling))
+        return get_cycles();
+    return 0;
+}
+
+/**
+ * @brief Account the cycles spent in @stage since @start, returned by event_stats_begin().
+ */
+static __always_inline void event_stats_end(enum event_stage stage, u64 start)
+{
+    if (likely(!start))
+        return;
+    const u64 cycles = get_cycles() - start;
+    this_cpu_inc(event_stats.cycles[stage][min_t(unsigned int, fls64(cycles), EVENT_STATS_CYCLE_BUCKETS - 1)]);
+}
+
+#endif // __SCC_EVENT_STATS_H__
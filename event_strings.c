@@ -0,0 +1,151 @@
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/bitmap.h>
+#include <linux/uaccess.h>
+#include <linux/unistd.h>
+#include <linux/version.h>
+
+#include "event_strings.h"
+#include "event_config.h"
+#include "syscall_hook.h"
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0)
+#define strncpy_from_user_nofault strncpy_from_unsafe_user
+#define copy_from_user_nofault probe_user_read
+#endif
+
+// an entry holds the argument + 1, 0 ends the list
+#define STRING_ARG(arg) ((arg) + 1)
+// the argument is a NULL terminated array of strings, like argv
+#define STRING_ARRAY 0x80
+#define STRING_ARGV(arg) (STRING_ARG(arg) | STRING_ARRAY)
+
+#ifdef CONFIG_X86_64
+static const u8 string_args[][EVENT_STRINGS_MAX] = {
+    [__NR_open] = {STRING_ARG(0)},
+    [__NR_stat] = {STRING_ARG(0)},
+    [__NR_lstat] = {STRING_ARG(0)},
+    [__NR_access] = {STRING_ARG(0)},
+    [__NR_execve] = {STRING_ARG(0), STRING_ARGV(1)},
+    [__NR_truncate] = {STRING_ARG(0)},
+    [__NR_chdir] = {STRING_ARG(0)},
+    [__NR_rename] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_mkdir] = {STRING_ARG(0)},
+    [__NR_rmdir] = {STRING_ARG(0)},
+    [__NR_creat] = {STRING_ARG(0)},
+    [__NR_link] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_unlink] = {STRING_ARG(0)},
+    [__NR_symlink] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_readlink] = {STRING_ARG(0)},
+    [__NR_chmod] = {STRING_ARG(0)},
+    [__NR_chown] = {STRING_ARG(0)},
+    [__NR_lchown] = {STRING_ARG(0)},
+    [__NR_mknod] = {STRING_ARG(0)},
+    [__NR_statfs] = {STRING_ARG(0)},
+    [__NR_chroot] = {STRING_ARG(0)},
+    [__NR_mount] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_umount2] = {STRING_ARG(0)},
+    [__NR_swapon] = {STRING_ARG(0)},
+    [__NR_swapoff] = {STRING_ARG(0)},
+    [__NR_setxattr] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_lsetxattr] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_getxattr] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_lgetxattr] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_removexattr] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_lremovexattr] = {STRING_ARG(0), STRING_ARG(1)},
+    [__NR_openat] = {STRING_ARG(1)},
+    [__NR_mkdirat] = {STRING_ARG(1)},
+    [__NR_mknodat] = {STRING_ARG(1)},
+    [__NR_fchownat] = {STRING_ARG(1)},
+    [__NR_newfstatat] = {STRING_ARG(1)},
+    [__NR_unlinkat] = {STRING_ARG(1)},
+    [__NR_renameat] = {STRING_ARG(1), STRING_ARG(3)},
+    [__NR_linkat] = {STRING_ARG(1), STRING_ARG(3)},
+    [__NR_symlinkat] = {STRING_ARG(0), STRING_ARG(2)},
+    [__NR_readlinkat] = {STRING_ARG(1)},
+    [__NR_fchmodat] = {STRING_ARG(1)},
+    [__NR_faccessat] = {STRING_ARG(1)},
+    [__NR_renameat2] = {STRING_ARG(1), STRING_ARG(3)},
+    [__NR_execveat] = {STRING_ARG(1), STRING_ARGV(2)},
+    [__NR_statx] = {STRING_ARG(1)},
+};
+#endif
+
+bool syscall_has_strings(long nr)
+{
+#ifdef CONFIG_X86_64
+    return nr >= 0 && nr < ARRAY_SIZE(string_args) && string_args[nr][0];
+#else
+    return false;
+#endif
+}
+
+// the length of the string copied to @dst without its NUL, @dst is always NUL terminated
+static unsigned int read_string(char *dst, const char __user *src, unsigned int size)
+{
+    // unlike strncpy_from_user(), counts the NUL, and returns the whole count when it cut the string
+    long len = src ? strncpy_from_user_nofault(dst, src, size - 1) : 0;
+    if (len <= 0)
+        len = 0;
+    else if (len < size - 1 || dst[len - 1] == '\0')
+        --len;
+    dst[len] = '\0';
+    return len;
+}
+
+// the strings of @argv joined by spaces, as much of them as fits
+static unsigned int read_string_array(char *dst, const char __user *const __user *argv, unsigned int size)
+{
+    unsigned int len = 0;
+    for (int i = 0; argv && len + 1 < size; ++i)
+    {
+        const char __user *arg;
+        if (copy_from_user_nofault(&arg, argv + i, sizeof(arg)) || !arg)
+            break;
+        if (i > 0)
+            dst[len++] = ' ';
+        len += read_string(dst + len, arg, size - len);
+    }
+    dst[len] = '\0';
+    return len;
+}
+
+unsigned int event_strings_capture(long nr, const uint64_t *args, struct event_strings *strings)
+{
+    strings->nr = 0;
+#ifdef CONFIG_X86_64
+    if (!syscall_has_strings(nr))
+        return 0;
+
+    for (int i = 0; i < EVENT_STRINGS_MAX && string_args[nr][i]; ++i)
+    {
+        const u8 arg = (string_args[nr][i] & ~STRING_ARRAY) - 1;
+        const void __user *src = (const void __user *)(unsigned long)args[arg];
+        strings->arg[i] = arg;
+        strings->len[i] = string_args[nr][i] & STRING_ARRAY
+                              ? read_string_array(strings->str[i], src, EVENT_STRING_SIZE)
+                              : read_string(strings->str[i], src, EVENT_STRING_SIZE);
+        strings->nr++;
+    }
+#endif
+    return strings->nr;
+}
+
+int event_strings_set(const unsigned long *syscalls, bool enable)
+{
+    struct scc_config *config = event_config_edit();
+    if (!config)
+        return -ENOMEM;
+
+    for (int i = 0; i < HOOK_NR_SYSCALLS; ++i)
+    {
+        if (syscalls && !test_bit(i, syscalls))
+            continue;
+        if (enable)
+            set_bit(i, config->strings);
+        else
+            clear_bit(i, config->strings);
+    }
+    event_config_publish(config);
+    return 0;
+}
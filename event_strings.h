@@ -0,0 +1,33 @@
+#ifndef __SCC_EVENT_STRINGS_H__
+#define __SCC_EVENT_STRINGS_H__
+#include <linux/types.h>
+
+#include "event_schema.h"
+
+/**
+ * @brief Whether the syscall @nr takes strings worth capturing, paths mostly.
+ */
+bool syscall_has_strings(long nr);
+
+/**
+ * @brief Read the string arguments of the syscall @nr from user memory into @strings.
+ *
+ * Each string is cut at EVENT_STRING_SIZE - 1 bytes. Never sleeps and never faults a
+ * page in, so it is safe in any context: a string that is not resident is captured empty.
+ *
+ * @param args The raw arguments of the syscall.
+ *
+ * @return The number of strings captured, also stored in `strings->nr`.
+ */
+unsigned int event_strings_capture(long nr, const uint64_t *args, struct event_strings *strings);
+
+/**
+ * @brief Start or stop capturing the strings of @syscalls.
+ *
+ * @param syscalls A bitmap of HOOK_NR_SYSCALLS bits, NULL for all of them.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int event_strings_set(const unsigned long *syscalls, bool enable);
+
+#endif // __SCC_EVENT_STRINGS_H__
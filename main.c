@@ -4,6 +4,8 @@
 #include <linux/mutex.h>
 
 #include "cdev.h"
+#include "event_logger.h"
+#include "syscall_hook.h"
 #include "glob_conf.h"
 
 // BSD licensed
@@ -19,11 +21,19 @@ static int __init __scc_init(void)
     printk(KERN_DEBUG "__scc_init\n");
     mutex_init(&scc_mutex);
 
+    int rc = event_logger_init();
+    if (rc < 0)
+    {
+        printk(KERN_ERR "Failed to initialize event logger\n");
+        return rc;
+    }
+
     // register char device
-    int rc = dev_init();
+    rc = dev_init();
     if (rc < 0)
     {
         printk(KERN_ERR "Failed to initialize char device\n");
+        event_logger_exit();
         return rc;
     }
 
@@ -34,7 +44,11 @@ static void __exit __scc_exit(void)
 {
     printk(KERN_DEBUG "__scc_exit\n");
     mutex_destroy(&scc_mutex);
+    // nothing may call into the module once it is gone
+    unhook_syscall(NULL);
+    drain_hooked_syscalls();
     dev_exit();
+    event_logger_exit();
 }
 
 // register init and exit function
@@ -8,50 +8,71 @@
 #include <linux/sched.h>
 #include <linux/cred.h>
 #include <linux/uaccess.h>
+#include <linux/bitmap.h>
+#include <linux/ptrace.h>
+#include <linux/linkage.h>
+#include <linux/stop_machine.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/workqueue.h>
 
 #include "syscall_hook.h"
-#include "our_syscall_table.h"
 #include "event_logger.h"
+#include "syscall_tracepoint.h"
 
-static int hooked = 0;
-int hook_syscall(void)
+// serialize the control path, the table itself is patched under stop_machine()
+static DEFINE_MUTEX(hook_mutex);
+static DECLARE_BITMAP(hooked_syscalls, HOOK_NR_SYSCALLS);
+static int update_hooked_syscalls(const unsigned long *wanted);
+
+/* How syscalls are captured, chosen at load time:
+ * - "table"      : patch the entries of sys_call_table (default)
+ * - "tracepoint" : attach probes to the sys_enter/sys_exit tracepoints
+ */
+static char *backend = "table";
+module_param(backend, charp, 0444);
+
+static inline bool use_tracepoints(void)
 {
-    long table = DETAIL(get_syscall_table)();
-    printk(KERN_DEBUG "syscall table: %lx\n", table);
+    return strcmp(backend, "tracepoint") == 0;
+}
 
-    // save original syscall table
-    int rc = DETAIL(save_original_syscall)();
-    if (rc < 0)
+int hook_syscall(const unsigned long *syscalls)
+{
+    if (!use_tracepoints())
     {
-        printk(KERN_ERR "Failed to save original syscall table\n");
-        return rc;
+        long table = DETAIL(get_syscall_table)();
+        printk(KERN_DEBUG "syscall table: %lx\n", table);
     }
 
-    rc = DETAIL(hook_syscall)();
+    DECLARE_BITMAP(wanted, HOOK_NR_SYSCALLS);
+    mutex_lock(&hook_mutex);
+    if (syscalls)
+        bitmap_or(wanted, hooked_syscalls, syscalls, HOOK_NR_SYSCALLS);
+    else
+        bitmap_fill(wanted, HOOK_NR_SYSCALLS);
+    int rc = update_hooked_syscalls(wanted);
+    mutex_unlock(&hook_mutex);
+
     if (rc < 0)
-    {
         printk(KERN_ERR "Failed to hook syscall\n");
-        return rc;
-    }
-
-    hooked = 1;
-    return 0;
+    return rc;
 }
 
-int unhook_syscall(void)
+int unhook_syscall(const unsigned long *syscalls)
 {
-    if (!hooked)
-        return 0;
+    DECLARE_BITMAP(wanted, HOOK_NR_SYSCALLS);
+    mutex_lock(&hook_mutex);
+    if (syscalls)
+        bitmap_andnot(wanted, hooked_syscalls, syscalls, HOOK_NR_SYSCALLS);
+    else
+        bitmap_zero(wanted, HOOK_NR_SYSCALLS);
+    int rc = update_hooked_syscalls(wanted);
+    mutex_unlock(&hook_mutex);
 
-    int rc = DETAIL(unhook_syscall)();
     if (rc < 0)
-    {
         printk(KERN_ERR "Failed to unhook syscall\n");
-        return rc;
-    }
-
-    hooked = 0;
-    return 0;
+    return rc;
 }
 
 //-------------------------- DETAIL ZONE --------------------------
@@ -91,13 +112,6 @@ module_param(sym, ulong, 0644);
 
 #endif /* Version < v5.7 */
 
-#ifdef DEFAULT_NR_SYSCALLS
-#define HOOK_NR_SYSCALLS DEFAULT_NR_SYSCALLS
-#else
-// #define HOOK_NR_SYSCALLS NR_SYSCALLS
-#define HOOK_NR_SYSCALLS 256
-#endif
-
 #define MSB (1UL << (sizeof(unsigned long) * 8 - 1))
 
 // We would skip 387 to 423, see: https://github.com/torvalds/linux/blob/df57721f9a63e8a1fb9b9b2e70de4aa4c7e0cd2e/arch/x86/entry/syscalls/syscall_64.tbl#L346
@@ -108,70 +122,63 @@ module_param(sym, ulong, 0644);
 #pragma message "HOOK_NR_SYSCALLS: " __stringify(HOOK_NR_SYSCALLS)
 
 static DEFINE_MUTEX(syacall_mutex);
+/* Never cleared: a task may have gone through a hooked entry just before it was restored
+ * and still be about to load its original. Stale once everything is unhooked, then saved
+ * again by the next hook.
+ */
 static unsigned long *orig_syscall_tale[HOOK_NR_SYSCALLS + 1];
-static unsigned long *our_syscall_table[HOOK_NR_SYSCALLS + 1];
-static void gen_our_syscall(void);
-
-/**
- * @brief tricky workaround for the kernel module building bug:
- * If we call the fp directly, the compiler would always give me 0x0 for that constant address.
- * It would generate asm like:
- * 0000000000000340 <NEW_FUNC_0>:
-     340:	f3 0f 1e fa          	endbr64
-     344:	e8 00 00 00 00       	call   349 <NEW_FUNC_0+0x9>
-     349:	50                   	push   rax
-     34a:	53                   	push   rbx
-     34b:	51                   	push   rcx
-     34c:	52                   	push   rdx
-     34d:	56                   	push   rsi
-     34e:	57                   	push   rdi
-     34f:	55                   	push   rbp
-     350:	48 c7 c0 00 00 00 00 	mov    rax,0x0
-     357:	ff d0                	call   rax
-     359:	5d                   	pop    rbp
-     35a:	5f                   	pop    rdi
-     35b:	5e                   	pop    rsi
-     35c:	5a                   	pop    rdx
-     35d:	59                   	pop    rcx
-     35e:	5b                   	pop    rbx
-     35f:	58                   	pop    rax
-     360:	48 8b 05 00 00 00 00 	mov    rax,QWORD PTR [rip+0x0]        # 367 <NEW_FUNC_0+0x27>
-     367:	ff d0                	call   rax
-     369:	e9 00 00 00 00       	jmp    36e <NEW_FUNC_0+0x2e>
-     36e:	66 90                	xchg   ax,ax
-
- * The compiler would generate a call to 0x0, which is not what we want.
- * So we use a function pointer to store the address, and call the function pointer.
- * The compiler would generate asm like:
- * ...
- * 0000000000000320 <NEW_FUNC_0>:
-     320:	f3 0f 1e fa          	endbr64
-     324:	e8 00 00 00 00       	call   329 <NEW_FUNC_0+0x9>
-     329:	50                   	push   rax
-     32a:	53                   	push   rbx
-     32b:	51                   	push   rcx
-     32c:	52                   	push   rdx
-     32d:	56                   	push   rsi
-     32e:	57                   	push   rdi
-     32f:	55                   	push   rbp
-     330:	48 8b 05 00 00 00 00 	mov    rax,QWORD PTR [rip+0x0]        # 337 <NEW_FUNC_0+0x17>
-     337:	ff d0                	call   rax
-     339:	5d                   	pop    rbp
-     33a:	5f                   	pop    rdi
-     33b:	5e                   	pop    rsi
-     33c:	5a                   	pop    rdx
-     33d:	59                   	pop    rcx
-     33e:	5b                   	pop    rbx
-     33f:	58                   	pop    rax
-     340:	48 8b 05 00 00 00 00 	mov    rax,QWORD PTR [rip+0x0]        # 347 <NEW_FUNC_0+0x27>
-     347:	ff d0                	call   rax
-     349:	e9 00 00 00 00       	jmp    34e <NEW_FUNC_0+0x2e>
-     34e:	66 90                	xchg   ax,ax
- *
- * The compiler would generate a call to the function pointer, which is what we want.
+static bool orig_syscall_saved;
+// the tasks inside scc_syscall(), a task may leave on another CPU than it entered, only the sum counts
+static DEFINE_PER_CPU(long, inflight_syscalls);
+/* A module reference held from the first hooked entry until every task that went through
+ * the trampoline has left it, so that rmmod fails with EBUSY instead of waiting on a task
+ * blocked in a hooked syscall. Under hook_mutex.
+ */
+static bool module_pinned;
+/* How long the drain waits for the tasks in flight before warning and retrying every second.
+ * It runs as work, the task unhooking everything is itself in flight when write() is hooked.
  */
-static void (*event_logger_fp)(void);
-static void (*post_event_logger_fp)(void);
+#define DRAIN_WAIT_MS 1000
+// the tasks in flight were reported once since the last full unhook
+static bool drain_warned;
+static void drain_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(drain_work, drain_work_fn);
+
+#ifndef CONFIG_ARCH_HAS_SYSCALL_WRAPPER
+#error "The syscall table backend needs syscalls taking a struct pt_regs, x86_64 has them since v4.17"
+#endif
+
+typedef asmlinkage long (*syscall_fn)(const struct pt_regs *regs);
+
+/* Every hooked entry of the table points to this one function. Since v4.17, x86_64
+ * syscalls take their arguments as a struct pt_regs and the number is in orig_ax, so
+ * nothing has to be preserved beyond what the C calling convention already does.
+ */
+static asmlinkage long scc_syscall(const struct pt_regs *regs)
+{
+    // before v5.4, x32 syscalls go through this table too, with __X32_SYSCALL_BIT left in orig_ax
+#ifdef __SYSCALL_MASK
+    const unsigned long nr = regs->orig_ax & __SYSCALL_MASK;
+#else
+    const unsigned long nr = regs->orig_ax;
+#endif
+    if (unlikely(nr >= HOOK_NR_SYSCALLS))
+        return -ENOSYS;
+
+    const syscall_fn orig = (syscall_fn)READ_ONCE(orig_syscall_tale[nr]);
+    // they never come back to be uncounted, and the logger has nothing to pair them with anyway
+    if (unlikely(nr == __NR_exit || nr == __NR_exit_group))
+        return orig(regs);
+
+    this_cpu_inc(inflight_syscalls);
+
+    // the exit only looks for an event if the entry left one
+    const enum event_entry entry = event_logger();
+    const long ret = orig(regs);
+    post_event_logger(ret, entry);
+    this_cpu_dec(inflight_syscalls);
+    return ret;
+}
 
 static unsigned long **acquire_sys_call_table(void)
 {
@@ -272,8 +279,8 @@ long DETAIL(get_syscall_table)(void)
 
 int DETAIL(save_original_syscall)(void)
 {
-    // it is not empty if it is hooked before, return invalid
-    if (orig_syscall_tale[0] != NULL)
+    // saved by a previous hook and still in use
+    if (orig_syscall_saved)
     {
         printk(KERN_ERR "syscall table is not empty\n");
         return -EINVAL;
@@ -291,29 +298,38 @@ int DETAIL(save_original_syscall)(void)
         printk(KERN_ERR "Failed to lock scc syscall mutex\n");
         return -EBUSY;
     }
+    // the previous table may still be read by tasks leaving the trampoline
     for (int i = 0; i < HOOK_NR_SYSCALLS; i++)
-        orig_syscall_tale[i] = table[i];
+        WRITE_ONCE(orig_syscall_tale[i], table[i]);
+    orig_syscall_saved = true;
     mutex_unlock(&syacall_mutex);
 
     return 0;
 }
 
-static int hook_syscall_impl(int nr, void *func)
+struct table_patch
 {
-    long **table = (long **)DETAIL(get_syscall_table)();
+    long **table;
+    const unsigned long *wanted;
+};
 
-    if (!mutex_trylock(&syacall_mutex))
-        return -EBUSY;
+// runs while every other CPU spins with interrupts off, so they all switch to the new table at once
+static int apply_table_patch(void *data)
+{
+    const struct table_patch *patch = data;
 
     disable_write_protection();
-    table[nr] = (unsigned long *)func;
+    for (int i = 0; i < HOOK_NR_SYSCALLS; i++)
+    {
+        const bool hook = test_bit(i, patch->wanted);
+        if (hook != test_bit(i, hooked_syscalls))
+            patch->table[i] = hook ? (long *)scc_syscall : (long *)orig_syscall_tale[i];
+    }
     enable_write_protection();
-
-    mutex_unlock(&syacall_mutex);
     return 0;
 }
 
-int DETAIL(hook_syscall)(void)
+int DETAIL(hook_syscall)(const unsigned long *wanted)
 {
     long **table = (long **)DETAIL(get_syscall_table)();
     if (!((unsigned long)table & MSB))
@@ -322,67 +338,170 @@ int DETAIL(hook_syscall)(void)
         return (int)(long long)table;
     }
 
-    DETAIL(get_our_syscall_table)
-    ();
-    printk(KERN_DEBUG "Hooking system call from 0 to %d\n", HOOK_NR_SYSCALLS);
-
-    for (int i = 0; i < HOOK_NR_SYSCALLS; i++)
+    // one patch window for the whole table, a half hooked table is never seen
+    struct table_patch patch = {
+        .table = table,
+        .wanted = wanted,
+    };
+    int rc = stop_machine(apply_table_patch, &patch, NULL);
+    if (rc < 0)
     {
-        if (i >= SKIP_SYSCALLS_START && i <= SKIP_SYSCALLS_END)
-            continue;
-
-        int rc = hook_syscall_impl(i, our_syscall_table[i]);
-        if (rc < 0)
-        {
-            printk(KERN_ERR "Failed to hook syscall: %d\n", i);
-            return rc;
-        }
+        printk(KERN_ERR "Failed to patch the syscall table: %d\n", rc);
+        return rc;
     }
+    bitmap_copy(hooked_syscalls, wanted, HOOK_NR_SYSCALLS);
     return 0;
 }
 
-static inline void clear_orig_syscall(void)
+static inline void mark_orig_syscall_stale(void)
 {
-    for (int i = 0; i < HOOK_NR_SYSCALLS; i++)
-        orig_syscall_tale[i] = NULL;
+    orig_syscall_saved = false;
 }
 
-int DETAIL(unhook_syscall)(void)
+// wait for the tasks that may be running the trampoline code without being counted
+static inline void sync_trampoline(void)
 {
-    long **table = (long **)DETAIL(get_syscall_table)();
-    if (!((unsigned long)table & MSB))
+    // tasks preempted between loading a table entry and calling it, or after leaving the count
+#ifdef CONFIG_TASKS_RCU
+    synchronize_rcu_tasks();
+#else
+    synchronize_rcu();
+#endif
+}
+
+static long inflight_sum(void)
+{
+    long inflight = 0;
+    int cpu;
+    for_each_possible_cpu(cpu)
+        inflight += per_cpu(inflight_syscalls, cpu);
+    return inflight;
+}
+
+// true once the tasks that went through the trampoline have left it, the table is already restored
+static bool wait_hooked_syscalls(unsigned int timeout_ms)
+{
+    // a task still about to enter the trampoline gets counted first
+    sync_trampoline();
+    // nobody enters anymore, so the sum can only be too high while tasks leave
+    for (unsigned int waited = 0; inflight_sum() > 0; waited += 20)
     {
-        printk(KERN_ERR "Failed to get syscall table\n");
-        return (int)(long long)table;
+        if (waited >= timeout_ms)
+            return false;
+        msleep(20);
     }
+    sync_trampoline();
+    return true;
+}
 
-    if (!mutex_trylock(&syacall_mutex))
+// under hook_mutex, after the table changed
+static void update_module_pin(void)
+{
+    if (!bitmap_empty(hooked_syscalls, HOOK_NR_SYSCALLS))
     {
-        printk(KERN_ERR "Failed to lock scc syscall mutex\n");
-        return -EBUSY;
+        if (!module_pinned)
+            __module_get(THIS_MODULE);
+        module_pinned = true;
+        return;
     }
+    if (module_pinned)
+    {
+        drain_warned = false;
+        mod_delayed_work(system_wq, &drain_work, 0);
+    }
+}
 
-    disable_write_protection();
-    for (int i = 0; i < HOOK_NR_SYSCALLS; i++)
+static void drain_work_fn(struct work_struct *work)
+{
+    mutex_lock(&hook_mutex);
+    // hooked again meanwhile, the next unhook drains them all
+    if (module_pinned && bitmap_empty(hooked_syscalls, HOOK_NR_SYSCALLS))
     {
-        if (i >= SKIP_SYSCALLS_START && i <= SKIP_SYSCALLS_END)
-            continue;
+        if (wait_hooked_syscalls(drain_warned ? 0 : DRAIN_WAIT_MS))
+        {
+            module_pinned = false;
+            // __scc_exit() waits for this work to return before the module goes away
+            module_put(THIS_MODULE);
+        }
+        else
+        {
+            if (!drain_warned)
+                printk(KERN_WARNING "%ld tasks are still in hooked syscalls, scc can be removed once they return\n", inflight_sum());
+            drain_warned = true;
+            schedule_delayed_work(&drain_work, HZ);
+        }
+    }
+    mutex_unlock(&hook_mutex);
+}
+
+void drain_hooked_syscalls(void)
+{
+    if (use_tracepoints())
+        return;
 
-        table[i] = orig_syscall_tale[i];
+    cancel_delayed_work_sync(&drain_work);
+    // the module is pinned while tasks are in flight, only a forced unload gets here with some left
+    if (!wait_hooked_syscalls(DRAIN_WAIT_MS))
+        printk(KERN_ERR "Unloading with %ld tasks still in hooked syscalls\n", inflight_sum());
+}
+
+static int update_hooked_syscalls(const unsigned long *wanted)
+{
+    DECLARE_BITMAP(hookable, HOOK_NR_SYSCALLS);
+    bitmap_copy(hookable, wanted, HOOK_NR_SYSCALLS);
+#if SKIP_SYSCALLS_START < HOOK_NR_SYSCALLS
+    bitmap_clear(hookable, SKIP_SYSCALLS_START, min(SKIP_SYSCALLS_END + 1, HOOK_NR_SYSCALLS) - SKIP_SYSCALLS_START);
+#endif
+
+    if (use_tracepoints())
+    {
+        int rc = syscall_tracepoint_update(hookable);
+        if (rc == 0)
+            bitmap_copy(hooked_syscalls, hookable, HOOK_NR_SYSCALLS);
+        return rc;
+    }
+    if (strcmp(backend, "table") != 0)
+    {
+        printk(KERN_ERR "Unknown backend %s\n", backend);
+        return -EINVAL;
     }
-    enable_write_protection();
 
-    clear_orig_syscall();
+    // the original table is saved by the first hook, and kept until everything is unhooked
+    if (bitmap_empty(hooked_syscalls, HOOK_NR_SYSCALLS))
+    {
+        if (bitmap_empty(hookable, HOOK_NR_SYSCALLS))
+            return 0;
 
-    mutex_unlock(&syacall_mutex);
+        int rc = DETAIL(save_original_syscall)();
+        if (rc < 0)
+        {
+            printk(KERN_ERR "Failed to save original syscall table\n");
+            return rc;
+        }
+    }
 
-    return 0;
+    int rc;
+    if (bitmap_empty(hookable, HOOK_NR_SYSCALLS))
+        rc = DETAIL(unhook_syscall)();
+    else
+    {
+        rc = DETAIL(hook_syscall)(hookable);
+        // nothing got hooked, the next hook saves the table again
+        if (bitmap_empty(hooked_syscalls, HOOK_NR_SYSCALLS))
+            mark_orig_syscall_stale();
+    }
+    update_module_pin();
+    return rc;
 }
 
-unsigned long **DETAIL(get_our_syscall_table)(void)
+int DETAIL(unhook_syscall)(void)
 {
-    gen_our_syscall();
-    return our_syscall_table;
-}
+    DECLARE_BITMAP(none, HOOK_NR_SYSCALLS);
+    bitmap_zero(none, HOOK_NR_SYSCALLS);
+    int rc = DETAIL(hook_syscall)(none);
+    if (rc < 0)
+        return rc;
 
-#include "syscall_table_gen.h"
+    mark_orig_syscall_stale();
+    return 0;
+}
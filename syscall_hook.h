@@ -1,9 +1,39 @@
 #ifndef __SCC_SYSCALL_HOOK_H__
 #define __SCC_SYSCALL_HOOK_H__
 
+#include <linux/unistd.h>
 
-int hook_syscall(void);
-int unhook_syscall(void);
+// every x86_64 syscall can be hooked, the trampoline serves them all
+#define HOOK_NR_SYSCALLS NR_syscalls
+
+/**
+ * @brief Hook the syscalls set in @syscalls, on top of the ones already hooked.
+ *
+ * @param syscalls A bitmap of HOOK_NR_SYSCALLS bits, NULL for all of them.
+ *
+ * Only the table entries that change are patched, untraced syscalls keep running natively.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int hook_syscall(const unsigned long *syscalls);
+
+/**
+ * @brief Restore the syscalls set in @syscalls, NULL for all of them.
+ *
+ * @return 0 on success, negative errno otherwise.
+ */
+int unhook_syscall(const unsigned long *syscalls);
+
+/**
+ * @brief Wait until no task runs the code of the module through the syscall table anymore.
+ *
+ * Tasks blocked in a hooked syscall, like a read() of a pipe, still return into the
+ * module once it is unhooked, so the module holds a reference on itself until they have
+ * and rmmod fails with EBUSY meanwhile. Call after unhook_syscall(NULL) and before the
+ * module goes away, only a forced unload still finds tasks to wait for, and it does not
+ * wait for them longer than a second.
+ */
+void drain_hooked_syscalls(void);
 
 /**
  * @brief This macro is used to introduce detail function.
@@ -30,7 +60,13 @@ long DETAIL(get_syscall_table)(void);
  */
 int DETAIL(save_original_syscall)(void);
 
-int DETAIL(hook_syscall)(void);
+/**
+ * @brief Patch the syscall table so that exactly the syscalls in @wanted are hooked.
+ * Every entry is changed in a single stop_machine() window, the CPUs switch all at once.
+ * ! not reentrantable function
+ * @return status code, 0 for success, o.w. failure
+ */
+int DETAIL(hook_syscall)(const unsigned long *wanted);
 
 /**
  * @brief Restore original syscall from static array
@@ -39,6 +75,4 @@ int DETAIL(hook_syscall)(void);
  */
 int DETAIL(unhook_syscall)(void);
 
-unsigned long **DETAIL(get_our_syscall_table)(void);
-
 #endif // __SCC_SYSCALL_HOOK_H__
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include <linux/percpu.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/err.h>
+#include <linux/bitops.h>
+#include <linux/minmax.h>
+#include <linux/string.h>
+
+#include "syscall_stats.h"
+#include "syscall_hook.h"
+
+// HOOK_NR_SYSCALLS counters on each CPU, indexed by the syscall number
+static struct syscall_stats __percpu *stats = NULL;
+
+static int syscall_stats_show(struct seq_file *m, void *v);
+DEFINE_SHOW_ATTRIBUTE(syscall_stats);
+static int syscall_latency_show(struct seq_file *m, void *v);
+DEFINE_SHOW_ATTRIBUTE(syscall_latency);
+
+int syscall_stats_init(struct dentry *dir)
+{
+    stats = __alloc_percpu(array_size(HOOK_NR_SYSCALLS, sizeof(struct syscall_stats)),
+                           __alignof__(struct syscall_stats));
+    if (!stats)
+    {
+        printk(KERN_ERR "Failed to allocate the syscall counters\n");
+        return -ENOMEM;
+    }
+
+    debugfs_create_file("syscalls", 0444, dir, NULL, &syscall_stats_fops);
+    debugfs_create_file("latency", 0444, dir, NULL, &syscall_latency_fops);
+    return 0;
+}
+
+void syscall_stats_exit(void)
+{
+    free_percpu(stats);
+    stats = NULL;
+}
+
+void syscall_stats_account(long nr, long ret)
+{
+    if (unlikely(nr < 0 || nr >= HOOK_NR_SYSCALLS || !stats))
+        return;
+
+    // this_cpu_*() are safe against preemption, nothing else touches the counters of this CPU
+    this_cpu_inc(stats[nr].calls);
+    if (IS_ERR_VALUE(ret))
+    {
+        this_cpu_inc(stats[nr].errors);
+        return;
+    }
+    this_cpu_inc(stats[nr].ret_buckets[min_t(unsigned int, fls64(ret), SYSCALL_STATS_RET_BUCKETS - 1)]);
+}
+
+void syscall_stats_account_latency(long nr, u64 ns)
+{
+    if (unlikely(nr < 0 || nr >= HOOK_NR_SYSCALLS || !stats))
+        return;
+
+    this_cpu_inc(stats[nr].latency_buckets[min_t(unsigned int, fls64(ns), SYSCALL_STATS_LATENCY_BUCKETS - 1)]);
+}
+
+void syscall_stats_clear(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct syscall_stats *s = per_cpu_ptr(stats, cpu);
+        for (long nr = 0; nr < HOOK_NR_SYSCALLS; ++nr)
+            memset(s + nr, 0, offsetof(struct syscall_stats, latency_buckets));
+    }
+}
+
+void syscall_stats_clear_latency(void)
+{
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        struct syscall_stats *s = per_cpu_ptr(stats, cpu);
+        for (long nr = 0; nr < HOOK_NR_SYSCALLS; ++nr)
+            memset(s[nr].latency_buckets, 0, sizeof(s[nr].latency_buckets));
+    }
+}
+
+void syscall_stats_snapshot(long nr, struct syscall_stats *sum)
+{
+    memset(sum, 0, sizeof(*sum));
+    if (nr < 0 || nr >= HOOK_NR_SYSCALLS)
+        return;
+
+    int cpu;
+    for_each_possible_cpu(cpu)
+    {
+        const struct syscall_stats *s = per_cpu_ptr(stats, cpu) + nr;
+        sum->calls += READ_ONCE(s->calls);
+        sum->errors += READ_ONCE(s->errors);
+        for (int i = 0; i < SYSCALL_STATS_RET_BUCKETS; ++i)
+            sum->ret_buckets[i] += READ_ONCE(s->ret_buckets[i]);
+        for (int i = 0; i < SYSCALL_STATS_LATENCY_BUCKETS; ++i)
+            sum->latency_buckets[i] += READ_ONCE(s->latency_buckets[i]);
+    }
+}
+
+// one line per syscall called at least once: "<nr> <calls> <errors> <ret_buckets...>"
+static int syscall_stats_show(struct seq_file *m, void *v)
+{
+    seq_puts(m, "# nr calls errors ret=0 ret<2 ret<4 ... ret>=16384\n");
+    for (long nr = 0; nr < HOOK_NR_SYSCALLS; ++nr)
+    {
+        struct syscall_stats sum;
+        syscall_stats_snapshot(nr, &sum);
+        if (sum.calls == 0)
+            continue;
+
+        seq_printf(m, "%ld %llu %llu", nr, sum.calls, sum.errors);
+        for (int i = 0; i < SYSCALL_STATS_RET_BUCKETS; ++i)
+            seq_printf(m, " %llu", sum.ret_buckets[i]);
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
+
+// one line per syscall measured at least once: "<nr> <latency_buckets...>"
+static int syscall_latency_show(struct seq_file *m, void *v)
+{
+    seq_puts(m, "# nr ns=0 ns<2 ns<4 ... ns>=2^30\n");
+    for (long nr = 0; nr < HOOK_NR_SYSCALLS; ++nr)
+    {
+        struct syscall_stats sum;
+        syscall_stats_snapshot(nr, &sum);
+
+        u64 total = 0;
+        for (int i = 0; i < SYSCALL_STATS_LATENCY_BUCKETS; ++i)
+            total += sum.latency_buckets[i];
+        if (total == 0)
+            continue;
+
+        seq_printf(m, "%ld", nr);
+        for (int i = 0; i < SYSCALL_STATS_LATENCY_BUCKETS; ++i)
+            seq_printf(m, " %llu", sum.latency_buckets[i]);
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
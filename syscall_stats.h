@@ -0,0 +1,67 @@
+#ifndef __SCC_SYSCALL_STATS_H__
+#define __SCC_SYSCALL_STATS_H__
+#include <linux/types.h>
+
+struct dentry;
+
+// ret_buckets[0] counts the returns of 0, ret_buckets[i] those in [2^(i-1), 2^i), the last one the rest
+#define SYSCALL_STATS_RET_BUCKETS 16
+// the same log2 buckets for durations in ns, the last one holds everything above 1 s
+#define SYSCALL_STATS_LATENCY_BUCKETS 32
+
+/**
+ * @brief The counters of one syscall, kept per CPU and summed when read.
+ */
+struct syscall_stats
+{
+    u64 calls;
+    // returns in [-MAX_ERRNO, -1], they are not bucketed
+    u64 errors;
+    u64 ret_buckets[SYSCALL_STATS_RET_BUCKETS];
+    // last, the counters above are cleared apart. Every syscall measured, captured or not
+    u64 latency_buckets[SYSCALL_STATS_LATENCY_BUCKETS];
+};
+
+/**
+ * @brief Allocate the counters and expose them as `syscalls` and `latency` under @dir.
+ *
+ * @return 0 on success, -ENOMEM otherwise.
+ */
+int syscall_stats_init(struct dentry *dir);
+
+void syscall_stats_exit(void);
+
+/**
+ * @brief Count a return of the syscall @nr on the current CPU.
+ *
+ * Never sleeps and never takes a lock.
+ */
+void syscall_stats_account(long nr, long ret);
+
+/**
+ * @brief Count a call of the syscall @nr that took @ns nanoseconds, on the current CPU.
+ */
+void syscall_stats_account_latency(long nr, u64 ns);
+
+/**
+ * @brief Zero the calls, errors and returns of every CPU.
+ *
+ * ! Nothing may count meanwhile, see set_event_logger_mode().
+ */
+void syscall_stats_clear(void);
+
+/**
+ * @brief Zero the latency histograms of every CPU.
+ *
+ * ! Nothing may measure meanwhile, see set_event_logger_latency().
+ */
+void syscall_stats_clear_latency(void);
+
+/**
+ * @brief Sum the counters of the syscall @nr over all CPUs.
+ *
+ * The CPUs keep counting meanwhile, so the sum is not an atomic snapshot.
+ */
+void syscall_stats_snapshot(long nr, struct syscall_stats *sum);
+
+#endif // __SCC_SYSCALL_STATS_H__
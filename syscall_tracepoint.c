@@ -0,0 +1,109 @@
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/bitmap.h>
+#include <linux/sched.h>
+#include <linux/ptrace.h>
+#include <linux/tracepoint.h>
+#include <linux/compat.h>
+#include <asm/syscall.h>
+
+#include "syscall_tracepoint.h"
+#include "syscall_hook.h"
+#include "event_logger.h"
+
+#ifdef CONFIG_HAVE_SYSCALL_TRACEPOINTS
+static DECLARE_BITMAP(traced_syscalls, HOOK_NR_SYSCALLS);
+static struct tracepoint *sys_enter_tp = NULL;
+static struct tracepoint *sys_exit_tp = NULL;
+static bool probes_registered = false;
+
+// ia32 syscalls fire the same tracepoints with their own numbers, the table backend never sees them
+static inline bool is_traced(long nr)
+{
+    return !in_compat_syscall() && nr >= 0 && nr < HOOK_NR_SYSCALLS && test_bit(nr, traced_syscalls);
+}
+
+static void probe_sys_enter(void *data, struct pt_regs *regs, long id)
+{
+    if (is_traced(id))
+        event_logger();
+}
+
+static void probe_sys_exit(void *data, struct pt_regs *regs, long ret)
+{
+    if (is_traced(syscall_get_nr(current, regs)))
+        post_event_logger(ret, EVENT_ENTRY_UNKNOWN);
+}
+
+// the syscall tracepoints are not exported, look them up by name
+static void lookup_tracepoint(struct tracepoint *tp, void *priv)
+{
+    if (strcmp(tp->name, "sys_enter") == 0)
+        sys_enter_tp = tp;
+    else if (strcmp(tp->name, "sys_exit") == 0)
+        sys_exit_tp = tp;
+}
+
+static int register_probes(void)
+{
+    if (!sys_enter_tp || !sys_exit_tp)
+        for_each_kernel_tracepoint(lookup_tracepoint, NULL);
+    if (!sys_enter_tp || !sys_exit_tp)
+    {
+        printk(KERN_ERR "Failed to find the syscall tracepoints\n");
+        return -ENOENT;
+    }
+
+    int rc = tracepoint_probe_register(sys_enter_tp, probe_sys_enter, NULL);
+    if (rc < 0)
+        return rc;
+    rc = tracepoint_probe_register(sys_exit_tp, probe_sys_exit, NULL);
+    if (rc < 0)
+    {
+        tracepoint_probe_unregister(sys_enter_tp, probe_sys_enter, NULL);
+        tracepoint_synchronize_unregister();
+        return rc;
+    }
+    return 0;
+}
+
+static void unregister_probes(void)
+{
+    tracepoint_probe_unregister(sys_exit_tp, probe_sys_exit, NULL);
+    tracepoint_probe_unregister(sys_enter_tp, probe_sys_enter, NULL);
+    // no probe may be running once this returns, the module can go away
+    tracepoint_synchronize_unregister();
+}
+
+int syscall_tracepoint_update(const unsigned long *wanted)
+{
+    // the probes check the bitmap word by word, a concurrent update is seen either way
+    bitmap_copy(traced_syscalls, wanted, HOOK_NR_SYSCALLS);
+
+    if (bitmap_empty(wanted, HOOK_NR_SYSCALLS))
+    {
+        if (probes_registered)
+            unregister_probes();
+        probes_registered = false;
+        return 0;
+    }
+
+    if (!probes_registered)
+    {
+        int rc = register_probes();
+        if (rc < 0)
+        {
+            bitmap_zero(traced_syscalls, HOOK_NR_SYSCALLS);
+            return rc;
+        }
+        probes_registered = true;
+    }
+    return 0;
+}
+#else
+int syscall_tracepoint_update(const unsigned long *wanted)
+{
+    printk(KERN_ERR "The kernel has no syscall tracepoints\n");
+    return -EOPNOTSUPP;
+}
+#endif // CONFIG_HAVE_SYSCALL_TRACEPOINTS
@@ -0,0 +1,19 @@
+#ifndef __SCC_SYSCALL_TRACEPOINT_H__
+#define __SCC_SYSCALL_TRACEPOINT_H__
+
+/**
+ * @brief Capture exactly the syscalls in @wanted through the sys_enter/sys_exit tracepoints.
+ *
+ * The alternative to patching the syscall table. Nothing is patched, the probes see every
+ * syscall and only pass the wanted ones to the event logger, with the return value taken
+ * from the tracepoint.
+ *
+ * @param wanted A bitmap of HOOK_NR_SYSCALLS bits, the probes are removed when it is empty.
+ *
+ * @return 0 on success, -EOPNOTSUPP without syscall tracepoints, negative errno otherwise.
+ *
+ * ! Callers serialize the updates.
+ */
+int syscall_tracepoint_update(const unsigned long *wanted);
+
+#endif // __SCC_SYSCALL_TRACEPOINT_H__
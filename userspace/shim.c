@@ -0,0 +1,79 @@
+#include <time.h>
+
+#include "shim.h"
+
+unsigned int nr_cpu_ids = 1;
+__thread int shim_cpu;
+__thread struct task_struct shim_task;
+
+// provided by the linker around the section of DEFINE_PER_CPU()
+extern char __start_shim_percpu[], __stop_shim_percpu[];
+static char *percpu_copies;
+static size_t percpu_size;
+
+void shim_init(unsigned int nr_cpus)
+{
+    nr_cpu_ids = nr_cpus;
+    percpu_size = (__stop_shim_percpu - __start_shim_percpu + 63) & ~(size_t)63;
+    percpu_copies = aligned_alloc(64, percpu_size * nr_cpus);
+    if (!percpu_copies)
+    {
+        fprintf(stderr, "Failed to allocate the per-CPU data of %u CPUs\n", nr_cpus);
+        exit(1);
+    }
+    // every per-CPU variable of the core starts zeroed
+    memset(percpu_copies, 0, percpu_size * nr_cpus);
+}
+
+void shim_set_cpu(int cpu)
+{
+    shim_cpu = cpu;
+}
+
+void *shim_per_cpu_ptr(const void *ptr, int cpu)
+{
+    return percpu_copies + cpu * percpu_size + ((const char *)ptr - __start_shim_percpu);
+}
+
+void *vmalloc_user(size_t size)
+{
+    void *p = aligned_alloc(PAGE_SIZE, PAGE_ALIGN(size));
+    if (p)
+        memset(p, 0, PAGE_ALIGN(size));
+    return p;
+}
+
+u64 ktime_get_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (u64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void init_waitqueue_head(wait_queue_head_t *wq)
+{
+    pthread_mutex_init(&wq->lock, NULL);
+    pthread_cond_init(&wq->cond, NULL);
+}
+
+void wake_up_interruptible(wait_queue_head_t *wq)
+{
+    pthread_mutex_lock(&wq->lock);
+    pthread_cond_broadcast(&wq->cond);
+    pthread_mutex_unlock(&wq->lock);
+}
+
+void shim_wait(wait_queue_head_t *wq)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_nsec += NSEC_PER_MSEC;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec += 1;
+        deadline.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&wq->lock);
+    pthread_cond_timedwait(&wq->cond, &wq->lock, &deadline);
+    pthread_mutex_unlock(&wq->lock);
+}
@@ -0,0 +1,311 @@
+#ifndef __SCC_SHIM_H__
+#define __SCC_SHIM_H__
+/* The part of the kernel API the event pipeline core uses, on top of libc and pthreads.
+ *
+ * Every <linux/...> and <asm/...> header of the core resolves to this one, see the Makefile.
+ * A "CPU" is whatever the calling thread claimed with shim_set_cpu(): the core relies on a
+ * single producer per CPU, so two threads must never push on the same CPU at the same time.
+ * Preemption does not exist, the atomics are the C11 ones with the kernel's ordering.
+ */
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#if defined(__x86_64__) && !defined(CONFIG_X86_64)
+#define CONFIG_X86_64
+#endif
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+// as in the kernel, whatever uint64_t is
+typedef unsigned long long u64;
+typedef int32_t s32;
+typedef long long s64;
+typedef s64 ktime_t;
+typedef unsigned int gfp_t;
+typedef unsigned int __poll_t;
+
+#undef __always_inline
+#define __always_inline inline __attribute__((always_inline))
+#define noinline __attribute__((noinline))
+#define asmlinkage
+#define __rcu
+#define __percpu
+#define __user
+#define likely(x) __builtin_expect(!!(x), 1)
+#define unlikely(x) __builtin_expect(!!(x), 0)
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
+#define min_t(type, a, b) ((type)(a) < (type)(b) ? (type)(a) : (type)(b))
+#define max_t(type, a, b) ((type)(a) > (type)(b) ? (type)(a) : (type)(b))
+#define clamp_t(type, v, lo, hi) min_t(type, max_t(type, v, lo), hi)
+#define U32_MAX 0xffffffffU
+#define NSEC_PER_USEC 1000L
+#define NSEC_PER_MSEC 1000000L
+
+#define KERN_ERR "scc: error: "
+#define KERN_INFO "scc: "
+#define printk(...) fprintf(stderr, __VA_ARGS__)
+
+#define ERESTARTSYS 512
+#define EPOLLIN 0x1
+#define EPOLLRDNORM 0x40
+
+#define LINUX_VERSION_CODE KERNEL_VERSION(6, 8, 0)
+#define KERNEL_VERSION(a, b, c) (((a) << 16) + ((b) << 8) + (c))
+
+static inline unsigned int fls64(u64 x)
+{
+    return x ? 64 - __builtin_clzll(x) : 0;
+}
+
+// atomics, the racy accesses the kernel marks are relaxed atomics here so that TSan sees them
+#define READ_ONCE(x) __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define smp_load_acquire(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define smp_store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define cmpxchg(p, old, new)                                                                     \
+    ({                                                                                           \
+        __typeof__(*(p)) __old = (old);                                                          \
+        __atomic_compare_exchange_n((p), &__old, (new), false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
+        __old;                                                                                   \
+    })
+#define xchg(p, v) __atomic_exchange_n((p), (v), __ATOMIC_SEQ_CST)
+#define barrier() __asm__ __volatile__("" ::: "memory")
+/* The copies too large for an atomic, whose races the core detects afterwards. Only their
+ * reads are hidden from TSan, like KCSAN ignores data_race() in the kernel.
+ */
+#ifdef __SANITIZE_THREAD__
+void AnnotateIgnoreReadsBegin(const char *file, int line);
+void AnnotateIgnoreReadsEnd(const char *file, int line);
+#define data_race(expr)                                \
+    ({                                                 \
+        AnnotateIgnoreReadsBegin(__FILE__, __LINE__);  \
+        __auto_type __v = (expr);                      \
+        AnnotateIgnoreReadsEnd(__FILE__, __LINE__);    \
+        __v;                                           \
+    })
+#else
+#define data_race(expr) (expr)
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#else
+#define cpu_relax() barrier()
+#endif
+
+// CPUs
+extern unsigned int nr_cpu_ids;
+extern __thread int shim_cpu;
+#define smp_processor_id() shim_cpu
+#define raw_smp_processor_id() shim_cpu
+#define for_each_possible_cpu(cpu) for ((cpu) = 0; (cpu) < (int)nr_cpu_ids; ++(cpu))
+#define cpu_to_node(cpu) 0
+#define preempt_disable() barrier()
+#define preempt_enable() barrier()
+
+/**
+ * @brief Set the number of CPUs and allocate their per-CPU data, before anything else.
+ */
+void shim_init(unsigned int nr_cpus);
+
+/**
+ * @brief Run the calling thread as @cpu.
+ */
+void shim_set_cpu(int cpu);
+
+/* Per-CPU variables live in their own section, which is copied once per CPU like the
+ * kernel does. per_cpu_ptr() turns the address of a variable into the one of its copy.
+ */
+#define DEFINE_PER_CPU(type, name) __attribute__((section("shim_percpu"), aligned(64))) __typeof__(type) name
+#define DECLARE_PER_CPU(type, name) extern __typeof__(type) name
+void *shim_per_cpu_ptr(const void *ptr, int cpu);
+#define per_cpu_ptr(ptr, cpu) ((__typeof__(ptr))shim_per_cpu_ptr((ptr), (cpu)))
+#define this_cpu_ptr(ptr) per_cpu_ptr(ptr, smp_processor_id())
+// the counters are read from other CPUs, keep them atomic
+#define this_cpu_add(var, n) __atomic_fetch_add(this_cpu_ptr(&(var)), (n), __ATOMIC_RELAXED)
+#define this_cpu_inc(var) this_cpu_add(var, 1)
+
+// memory
+#define GFP_KERNEL 0
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1UL << PAGE_SHIFT)
+#define PAGE_ALIGN(x) (((x) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+#define array_size(a, b) ((size_t)(a) * (size_t)(b))
+#define kzalloc(size, gfp) calloc(1, (size))
+#define kmalloc(size, gfp) malloc(size)
+#define kvmalloc_node(size, gfp, node) malloc(size)
+#define kfree(p) free((void *)(p))
+#define kvfree(p) free((void *)(p))
+#define vfree(p) free((void *)(p))
+void *vmalloc_user(size_t size);
+
+// lock-less lists
+struct llist_node
+{
+    struct llist_node *next;
+};
+struct llist_head
+{
+    struct llist_node *first;
+};
+#define llist_entry(ptr, type, member) container_of(ptr, type, member)
+
+static inline void init_llist_head(struct llist_head *list)
+{
+    WRITE_ONCE(list->first, NULL);
+}
+
+static inline bool llist_add(struct llist_node *node, struct llist_head *head)
+{
+    struct llist_node *first = READ_ONCE(head->first);
+    do
+        WRITE_ONCE(node->next, first);
+    while (!__atomic_compare_exchange_n(&head->first, &first, node, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    return first == NULL;
+}
+
+// a single consumer at a time, like the kernel one
+static inline struct llist_node *llist_del_first(struct llist_head *head)
+{
+    struct llist_node *entry = __atomic_load_n(&head->first, __ATOMIC_ACQUIRE);
+    while (entry && !__atomic_compare_exchange_n(&head->first, &entry, READ_ONCE(entry->next), false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+        ;
+    return entry;
+}
+
+// hashing
+#define GOLDEN_RATIO_64 0x61C8864680B583EBull
+static inline u32 hash_64(u64 val, unsigned int bits)
+{
+    return val * GOLDEN_RATIO_64 >> (64 - bits);
+}
+#define hash_ptr(ptr, bits) hash_64((unsigned long)(ptr), (bits))
+
+// time
+#define HZ 1000
+u64 ktime_get_ns(void);
+#define ktime_get() ((ktime_t)ktime_get_ns())
+#define ktime_to_ns(t) ((s64)(t))
+#define local_clock() ktime_get_ns()
+#define jiffies ((unsigned long)(ktime_get_ns() / (NSEC_PER_MSEC * 1000 / HZ)))
+#define msecs_to_jiffies(ms) ((unsigned long)(ms) * HZ / 1000)
+#define jiffies_to_msecs(j) ((unsigned int)((j) * 1000 / HZ))
+static inline u64 get_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return ktime_get_ns();
+#endif
+}
+
+// tasks, only their address and flags are used
+#define PF_KTHREAD 0x00200000
+struct task_struct
+{
+    unsigned int flags;
+};
+extern __thread struct task_struct shim_task;
+#define current (&shim_task)
+#define rt_task(task) 0
+
+// wait queues, every wakeup is a broadcast
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} wait_queue_head_t;
+void init_waitqueue_head(wait_queue_head_t *wq);
+void wake_up_interruptible(wait_queue_head_t *wq);
+// re-check @cond every millisecond too, the producers do not lock before waking up
+void shim_wait(wait_queue_head_t *wq);
+#define wq_has_sleeper(wq) true
+#define wait_event_interruptible(wq, cond) \
+    ({                                     \
+        while (!(cond))                    \
+            shim_wait(&(wq));              \
+        0;                                 \
+    })
+
+/* Timers never fire, the core only uses them for the wakeup timeout which the
+ * harness leaves disabled.
+ */
+struct timer_list
+{
+    void (*function)(struct timer_list *);
+    bool pending;
+};
+#define timer_setup(timer, fn, flags) ((timer)->function = (fn), (timer)->pending = false)
+#define timer_pending(timer) READ_ONCE((timer)->pending)
+
+static inline int mod_timer(struct timer_list *timer, unsigned long expires)
+{
+    WRITE_ONCE(timer->pending, true);
+    return 0;
+}
+
+static inline int timer_delete_sync(struct timer_list *timer)
+{
+    WRITE_ONCE(timer->pending, false);
+    return 0;
+}
+
+// files, mmap() and poll() only exist in the kernel
+struct file;
+struct poll_table_struct;
+#define VM_WRITE 0x2
+#define VM_MAYWRITE 0x20
+struct vm_area_struct
+{
+    unsigned long vm_pgoff;
+    unsigned long vm_flags;
+};
+#define poll_wait(filp, wq, wait) ((void)(wq))
+#define remap_vmalloc_range(vma, addr, pgoff) (-ENOSYS)
+#define vm_flags_clear(vma, flags) ((vma)->vm_flags &= ~(flags))
+
+// debugfs files become plain show callbacks
+struct seq_file
+{
+    FILE *file;
+};
+#define seq_printf(m, ...) fprintf((m)->file, __VA_ARGS__)
+#define seq_puts(m, s) fputs((s), (m)->file)
+#define seq_putc(m, c) fputc((c), (m)->file)
+struct dentry;
+struct file_operations
+{
+    int (*show)(struct seq_file *m, void *v);
+};
+#define DEFINE_SHOW_ATTRIBUTE(name) static const struct file_operations name##_fops = {.show = name##_show}
+static inline struct dentry *debugfs_create_file(const char *name, unsigned short mode, struct dentry *parent, void *data,
+                                                 const struct file_operations *fops)
+{
+    return NULL;
+}
+
+// static keys are plain flags
+struct static_key_false
+{
+    bool enabled;
+};
+#define DEFINE_STATIC_KEY_FALSE(name) struct static_key_false name = {false}
+#define DECLARE_STATIC_KEY_FALSE(name) extern struct static_key_false name
+#define static_branch_unlikely(key) unlikely(READ_ONCE((key)->enabled))
+#define static_branch_enable(key) WRITE_ONCE((key)->enabled, true)
+#define static_branch_disable(key) WRITE_ONCE((key)->enabled, false)
+
+// module parameters are fixed at their defaults
+#define module_param(name, type, perm)
+
+#endif // __SCC_SHIM_H__
@@ -0,0 +1,298 @@
+/* Hammer the event pipeline core from many threads.
+ *
+ * Each producer plays syscalls on its own CPU: an event taken from the pool and parked in
+ * the correlation cache at entry, taken back at exit, converted and pushed to the rings of
+ * every consumer. Each consumer drains its rings and checks every record: not torn, in
+ * order, and every event either read or counted as lost.
+ *
+ * usage: scc_stress [-p producers] [-c consumers] [-d duration_ms] [-t tasks] [-o policy] [-b block_us]
+ */
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "event_logger.h"
+#include "event_cache.h"
+#include "event_pool.h"
+#include "event_record.h"
+#include "event_ring.h"
+#include "event_stats.h"
+#include "event_schema.h"
+
+// records moved out of the rings at a time, the same as a read() of the module
+#define READ_CHUNK 64
+
+struct producer
+{
+    pthread_t thread;
+    int cpu;
+    // in-flight syscalls, one per task
+    int nr_tasks;
+    struct task_struct *tasks;
+    u64 produced;
+    // nothing in the cache at exit
+    u64 missed;
+};
+
+struct consumer
+{
+    pthread_t thread;
+    int cpu;
+    struct event_rings *rings;
+    u64 consumed;
+    u64 reported;
+    u64 gaps;
+    u64 torn;
+    u64 disordered;
+    // the next seq expected on each ring
+    u64 *next_seq;
+};
+
+static struct producer *producers;
+static struct consumer *consumers;
+static int nr_producers = 4, nr_consumers = 1, nr_tasks = 4;
+static atomic_bool stop, producers_done;
+
+static void enter_syscall(struct producer *producer, int task, u64 serial)
+{
+    struct event *cached_event = event_pool_alloc();
+    if (!cached_event)
+        return;
+
+    // what cache_event() does, minus the strings
+    struct event event = {
+        .task = producer->tasks + task,
+        .info.data.nr = serial % 300,
+        .info.data.args = {serial, ~serial, producer->cpu, task},
+        .tstamp = ktime_get(),
+        .pid = producer->cpu,
+        .tgid = task,
+        .weight = 1,
+    };
+    event_cache_fill(cached_event, &event);
+    event_cache_insert(cached_event);
+}
+
+static void exit_syscall(struct producer *producer, int task)
+{
+    struct event *cached_event = event_cache_take(producer->tasks + task);
+    if (!cached_event)
+    {
+        ++producer->missed;
+        return;
+    }
+
+    // what log_syscall_exit() does
+    cached_event->ret = 0;
+    struct event_record record = {0};
+    event_to_schema(cached_event, &record.schema);
+    record.weight = cached_event->weight;
+    for (int i = 0; i < nr_consumers; ++i)
+        event_rings_push(consumers[i].rings, &record, NULL);
+    event_pool_free(cached_event);
+    ++producer->produced;
+}
+
+static void *producer_main(void *arg)
+{
+    struct producer *producer = arg;
+    shim_set_cpu(producer->cpu);
+
+    // keep nr_tasks - 1 syscalls in flight, so that the cache holds several events per producer
+    const int n = producer->nr_tasks;
+    for (int task = 1; task < n; ++task)
+        enter_syscall(producer, task, task);
+    u64 serial = n;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed))
+    {
+        const int task = serial % n;
+        enter_syscall(producer, task, serial);
+        exit_syscall(producer, (task + 1) % n);
+        ++serial;
+    }
+    // the last task entered is the one before the last to exit
+    for (int i = 1; i < n; ++i)
+        exit_syscall(producer, (serial + i) % n);
+    return NULL;
+}
+
+static void check_records(struct consumer *consumer, const struct event_record *records, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        const struct event_record *record = records + i;
+        u64 *next_seq = consumer->next_seq + record->cpu;
+        if (record->seq < *next_seq)
+            ++consumer->disordered;
+        else
+            consumer->gaps += record->seq - *next_seq;
+
+        if (record->flags & EVENT_RECORD_LOST)
+        {
+            // carries the seq of the next event, without taking it
+            consumer->reported += record->weight;
+            *next_seq = record->seq;
+            continue;
+        }
+        *next_seq = record->seq + 1;
+        if (record->schema.syscall_args[1] != ~record->schema.syscall_args[0] || record->schema.pid != record->cpu)
+            ++consumer->torn;
+        ++consumer->consumed;
+    }
+}
+
+static void *consumer_main(void *arg)
+{
+    struct consumer *consumer = arg;
+    shim_set_cpu(consumer->cpu);
+
+    struct event_record records[READ_CHUNK];
+    while (1)
+    {
+        // read everything pushed before the producers were done
+        const bool done = atomic_load(&producers_done);
+        const int size = event_rings_pop(consumer->rings, records, NULL, READ_CHUNK);
+        check_records(consumer, records, size);
+        if (size == 0 && done)
+            break;
+    }
+    return NULL;
+}
+
+static u64 sum_stat(enum event_stat stat)
+{
+    u64 sum = 0;
+    int cpu;
+    for_each_possible_cpu(cpu)
+        sum += READ_ONCE(per_cpu_ptr(&event_stats, cpu)->counters[stat]);
+    return sum;
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "usage: %s [-p producers] [-c consumers] [-d duration_ms] [-t tasks] [-o drop-oldest|drop-newest|block] [-b block_us]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    static const char *const policies[] = {
+        [EVENT_OVERFLOW_DROP_OLDEST] = "drop-oldest",
+        [EVENT_OVERFLOW_DROP_NEWEST] = "drop-newest",
+        [EVENT_OVERFLOW_BLOCK] = "block",
+    };
+    enum event_overflow overflow = EVENT_OVERFLOW_DROP_OLDEST;
+    unsigned int duration_ms = 1000, block_us = 100;
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:d:t:o:b:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            nr_producers = atoi(optarg);
+            break;
+        case 'c':
+            nr_consumers = atoi(optarg);
+            break;
+        case 'd':
+            duration_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            nr_tasks = atoi(optarg);
+            break;
+        case 'o':
+            for (overflow = 0; overflow < ARRAY_SIZE(policies) && strcmp(optarg, policies[overflow]); ++overflow)
+                ;
+            if (overflow == ARRAY_SIZE(policies))
+                usage(argv[0]);
+            break;
+        case 'b':
+            block_us = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (nr_producers < 1 || nr_consumers < 1 || nr_tasks < 2 || duration_ms == 0)
+        usage(argv[0]);
+
+    // producers on CPUs [0, nr_producers), consumers on the next ones, their rings stay empty
+    shim_init(nr_producers + nr_consumers);
+    if (event_pool_init() < 0)
+        return 1;
+
+    producers = calloc(nr_producers, sizeof(struct producer));
+    consumers = calloc(nr_consumers, sizeof(struct consumer));
+    for (int i = 0; i < nr_consumers; ++i)
+    {
+        consumers[i].cpu = nr_producers + i;
+        consumers[i].next_seq = calloc(nr_cpu_ids, sizeof(u64));
+        consumers[i].rings = event_rings_create();
+        if (!consumers[i].rings)
+            return 1;
+        event_rings_set_overflow(consumers[i].rings, overflow, block_us);
+        pthread_create(&consumers[i].thread, NULL, consumer_main, consumers + i);
+    }
+
+    const u64 start = ktime_get_ns();
+    for (int i = 0; i < nr_producers; ++i)
+    {
+        producers[i].cpu = i;
+        producers[i].nr_tasks = nr_tasks;
+        producers[i].tasks = calloc(nr_tasks, sizeof(struct task_struct));
+        pthread_create(&producers[i].thread, NULL, producer_main, producers + i);
+    }
+
+    usleep(duration_ms * 1000);
+    atomic_store(&stop, true);
+    u64 produced = 0, missed = 0;
+    for (int i = 0; i < nr_producers; ++i)
+    {
+        pthread_join(producers[i].thread, NULL);
+        produced += producers[i].produced;
+        missed += producers[i].missed;
+    }
+    const double seconds = (ktime_get_ns() - start) / 1e9;
+    atomic_store(&producers_done, true);
+
+    printf("producers %d consumers %d tasks %d policy %s duration %.2f s\n",
+           nr_producers, nr_consumers, nr_tasks, policies[overflow], seconds);
+    printf("produced %llu events, %.2f Mevents/s, pushed to every consumer\n", (unsigned long long)produced, produced / seconds / 1e6);
+
+    int rc = 0;
+    for (int i = 0; i < nr_consumers; ++i)
+    {
+        struct consumer *consumer = consumers + i;
+        pthread_join(consumer->thread, NULL);
+
+        u64 lost = 0, offered = 0;
+        int cpu;
+        for_each_possible_cpu(cpu)
+        {
+            lost += consumer->rings->area->rings[cpu].lost;
+            offered += consumer->rings->area->rings[cpu].seq;
+        }
+        printf("consumer %d: consumed %llu events, %.2f Mevents/s, lost %llu (%.2f%%), %llu reported in-band, %llu seq gaps\n",
+               i, (unsigned long long)consumer->consumed, consumer->consumed / seconds / 1e6, (unsigned long long)lost,
+               produced ? 100.0 * lost / produced : 0, (unsigned long long)consumer->reported, (unsigned long long)consumer->gaps);
+
+        // every event offered to the rings is either read or counted as lost
+        if (consumer->torn || consumer->disordered || offered != produced || consumer->consumed + lost != produced || consumer->reported > lost)
+        {
+            printf("consumer %d: FAILED, %llu torn, %llu out of order, %llu offered\n",
+                   i, (unsigned long long)consumer->torn, (unsigned long long)consumer->disordered, (unsigned long long)offered);
+            rc = 1;
+        }
+        event_rings_destroy(consumer->rings);
+        free(consumer->next_seq);
+    }
+
+    printf("cache: %llu missed at exit, %llu evicted, %llu full, %llu retries; pool: %llu exhausted; rings: %llu retries\n",
+           (unsigned long long)missed,
+           (unsigned long long)sum_stat(EVENT_STAT_CACHE_EVICTED), (unsigned long long)sum_stat(EVENT_STAT_CACHE_FULL),
+           (unsigned long long)sum_stat(EVENT_STAT_CACHE_RETRIES), (unsigned long long)sum_stat(EVENT_STAT_ALLOC_FAILED),
+           (unsigned long long)sum_stat(EVENT_STAT_RING_RETRIES));
+
+    event_cache_clear();
+    event_pool_exit();
+    return rc;
+}